@@ -62,4 +62,10 @@ DEPENDPATH += $$PWD/../libnoisered
 win32:CONFIG(release, debug|release): PRE_TARGETDEPS += $$PWD/../output/noisered.lib
 else:win32:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$PWD/../output/noisered.lib
 else:unix:!macx: PRE_TARGETDEPS += $$PWD/../output/libnoisered.a
-LIBS += -lfftw3  -lcwt
+LIBS += -lfftw3
+
+# Single precision processing path (fftwf). Must be the same for the library and its users.
+CONFIG(float) {
+DEFINES += NOISERED_FLOAT
+LIBS += -lfftw3f
+}
@@ -123,13 +123,13 @@ void AudioManager::loadOriginal(QString src)
 	int len = origFile->size();
 
 	qint16 *origDataBuf = new qint16[len/2];
-	origData = new double[len/2];
+	origData = new Real[len/2];
 
 	origFile->read((char*)origDataBuf, len);
 	origFile->close();
 
 	for(int i = 0; i < len / 2; ++i)
-		origData[i] = origDataBuf[i] / 32768.;
+		origData[i] = (Real) (origDataBuf[i] / 32768.);
 }
 
 void AudioManager::handleStateChanged(QAudio::State newState)
@@ -44,7 +44,7 @@ private:
 	bool loaded;
 
 	SubtractionManager s_mgr;
-	double *origData;
+	Real *origData;
 
 
 };
@@ -56,4 +56,10 @@ LIBS +=  -lQtMultimediaKit
 # QT += multimedia
 #}
 
-LIBS +=  -lcwt -lfftw3 -ldl -lpthread  -lasound -lz -lsndfile -lm -lpulse -lpulse-simple
+LIBS +=  -lfftw3 -ldl -lpthread  -lasound -lz -lsndfile -lm -lpulse -lpulse-simple
+
+# Single precision processing path (fftwf). Must be the same for the library and its users.
+CONFIG(float) {
+DEFINES += NOISERED_FLOAT
+LIBS += -lfftw3f
+}
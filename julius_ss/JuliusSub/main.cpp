@@ -4,6 +4,7 @@ extern "C"
 #include "../julius-4.2.3/julius/submain.h"
 }
 #include "../libnoisered/subtraction_manager.h"
+#include "../libnoisered/fft/fftwmanager.h"
 
 #include "audiomanager.h"
 #include <thread>
@@ -19,11 +20,15 @@ void start_thread(int argc, char* argv[])
 {
 	QCoreApplication a(argc, argv);
 
+	// Measured plans, without the planning delay once the wisdom file exists
+	FFTWManager::loadWisdom("fftw.wisdom");
+	FFTWManager::setPlannerEffort(FFTWManager::PlannerEffort::Measure);
 	s_data = new SubtractionManager(512, 16000);
 	#ifdef ENABLE_AUDIO
 	am = new AudioManager();
 	#endif
 	s_data->readParametersFromFile();
+	FFTWManager::saveWisdom("fftw.wisdom");
 
 	ready = true;
 
@@ -14,9 +14,7 @@ extern "C"
 #endif
 void computeSS(signed short int* buffer, int len)
 {
-	s_data->readBuffer(buffer, len);
-	s_data->execute();
-	s_data->writeBuffer(buffer);
+	s_data->process(buffer, buffer, len);
 
 #ifdef ENABLE_AUDIO
 	am->writeAudio(buffer, len);
@@ -32,6 +30,7 @@ void resetSS()
 {
 	//am->stop();
 	s_data->onDataUpdate();
+	s_data->resetStream();
 }
 
 #ifdef __cplusplus
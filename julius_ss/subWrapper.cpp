@@ -14,9 +14,7 @@ extern "C"
 void computeSS(signed short int* buffer, int len)
 {
 	std::cout << len << std::endl;
-	s_data->readBuffer(buffer, len);
-	s_data->execute();
-	s_data->writeBuffer(buffer);
+	s_data->process(buffer, buffer, len);
 
 	alsam->writeToQueue(buffer, len);
 }
@@ -24,6 +22,7 @@ void computeSS(signed short int* buffer, int len)
 void resetSS()
 {
 	s_data->onDataUpdate();
+	s_data->resetStream();
 }
 
 #ifdef __cplusplus
@@ -11,15 +11,15 @@ Estimation::Estimation(SubtractionManager &configuration):
 Estimation::Estimation(const Estimation &est):
 	conf(est.conf)
 {
-	noise_power = new double[conf.spectrumSize()];
-	std::copy_n(est.noise_power, conf.spectrumSize(), noise_power);
+	noise_power = new Real[conf.FFTSize()];
+	std::copy_n(est.noise_power, conf.FFTSize(), noise_power);
 }
 
 const Estimation &Estimation::operator=(const Estimation &est)
 {
 	delete[] noise_power;
-	noise_power = new double[conf.spectrumSize()];
-	std::copy_n(est.noise_power, conf.spectrumSize(), noise_power);
+	noise_power = new Real[conf.FFTSize()];
+	std::copy_n(est.noise_power, conf.FFTSize(), noise_power);
 
 	return *this;
 }
@@ -33,7 +33,7 @@ Estimation::~Estimation()
 void Estimation::onFFTSizeUpdate()
 {
 	delete[] noise_power;
-	noise_power = new double[conf.FFTSize()];
+	noise_power = new Real[conf.FFTSize()];
 	onDataUpdate();
 
 	specific_onFFTSizeUpdate();
@@ -46,7 +46,17 @@ void Estimation::onDataUpdate()
 	specific_onDataUpdate();
 }
 
-double *Estimation::noisePower()
+Real *Estimation::noisePower()
 {
 	return noise_power;
 }
+
+void Estimation::onFrameOutput(const Real *, const Real *)
+{
+
+}
+
+bool Estimation::usesFrameOutput() const
+{
+	return false;
+}
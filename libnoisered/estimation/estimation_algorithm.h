@@ -1,5 +1,6 @@
 #pragma once
 #include <complex>
+#include "../mathutils/real.h"
 
 class SubtractionManager;
 
@@ -21,7 +22,7 @@ class Estimation
 		 * @param input_spectrum Input from which the algorithm estimates
 		 * @return True if a reestimation was performed
 		 */
-		virtual bool operator()(std::complex<double>* input_spectrum) = 0;
+		virtual bool operator()(std::complex<Real>* input_spectrum) = 0;
 		/**
 		 * @brief Actions to perform if the FFT size changes.
 		 *
@@ -41,7 +42,27 @@ class Estimation
 		 * @brief noisePower
 		 * @return the estimated noise power.
 		 */
-		virtual double* noisePower();
+		virtual Real* noisePower();
+
+		/**
+		 * @brief Receives the output of the frame, after the subtraction and the backward FFT.
+		 *
+		 * Called by the manager after each frame, for the algorithms which refine
+		 * the estimation of the next frames from the processed one. Does nothing by default.
+		 *
+		 * @param gain Gain applied to each bin by the subtraction.
+		 * @param output Output of the backward FFT, not normalized. FFT size.
+		 */
+		virtual void onFrameOutput(const Real* gain, const Real* output);
+
+		/**
+		 * @brief Tells if the algorithm uses onFrameOutput().
+		 *
+		 * The manager then processes the frames one after the other.
+		 *
+		 * @return bool false by default.
+		 */
+		virtual bool usesFrameOutput() const;
 
 	protected:
 		/**
@@ -55,5 +76,5 @@ class Estimation
 		virtual void specific_onDataUpdate() = 0;
 
 		SubtractionManager& conf;
-		double* noise_power = nullptr;
+		Real* noise_power = nullptr;
 };
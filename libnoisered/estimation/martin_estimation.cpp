@@ -1,90 +1,28 @@
 #include <cmath>
 #include <climits>
 #include <cfloat>
-#include <numeric>
 #include <algorithm>
 #include <iostream>
+#include <limits>
 
 #include "subtraction_manager.h"
 #include "mathutils/math_util.h"
+#include "mathutils/subtraction_kernels.h"
 #include "martin_estimation.h"
 using namespace std;
 
-// Note to future self : ban the static keyword in the 9th circle of hell
-void MartinEstimation::algo(std::complex<double> *spectrum, int nrf, double *x, double tinc, bool reinit, bool lastcall)
+Real *MartinEstimation::array(const MartinArray a)
 {
-	static int subwc;
-	static int segment_number;
-	static double *yft = nullptr;
-	static double *p = nullptr;
-	static double *sn2 = nullptr;
-	static double *pb = nullptr;
-	static double *pminu = nullptr;
-	static double *pb2 = nullptr;
-	static double *actmin = nullptr;
-	static double *actminsub = nullptr;
-
-	static double *ah = nullptr;
-	static double *b = nullptr;
-	static double *qeqi = nullptr;
-	static double *bmind = nullptr;
-	static double *bminv = nullptr;
-	static double *lmin = nullptr;
-	static double *qisq = nullptr;
-	static bool *kmod = nullptr;
-	static bool *lminflag = nullptr;
-	static double **actbuf = nullptr;
-
-	static MartinEstimation::MartinNoiseParams qq;
-
-	static int nu;
-	static int ibuf;
-	static double ac;
-	static double aca;
-	static double acmax;
-	static double amax;
-	static double aminh;
-	static double bmax;
-	static double snrexp;
-	static double nv, nd;
-	static double md, hd, mv, hv;
-	static double qeqimax;
-	static double qeqimin;
-	static double nsms[4];
-
-	if(lastcall)
-	{
-		delete[] ah;
-		delete[] b;
-		delete[] qeqi;
-		delete[] bmind;
-		delete[] bminv;
-		delete[] lmin;
-		delete[] qisq;
-		delete[] kmod;
-
-		delete[] yft;
-		delete[] p;
-		delete[] sn2;
-		delete[] pb;
-		delete[] pminu;
-		delete[] pb2;
-		delete[] lminflag;
-		delete[] actmin;
-		delete[] actminsub;
-
-		if (actbuf)
-		{
-			for (int i = 0; i < nu; ++i)
-			{
-				delete[] actbuf[i];
-			}
-			delete[] actbuf;
-		}
+	return _arena.data() + a * _nrf;
+}
 
-		return;
-	}
+Real *MartinEstimation::actbufRow(const int row)
+{
+	return _arena.data() + (NumArrays + row) * _nrf;
+}
 
+void MartinEstimation::algo(std::complex<Real> *spectrum, int nrf, Real *x, double tinc, bool reinit)
+{
 	// Initialisation
 	if (reinit)
 	{
@@ -138,148 +76,118 @@ void MartinEstimation::algo(std::complex<double> *spectrum, int nrf, double *x,
 		qeqimax = 1. / qq.qeqmin;  // maximum value of Qeq inverse (23)
 		qeqimin = 1. / qq.qeqmax; // minumum value of Qeq per frame inverse
 
-		if (ah) delete[] ah;
-		ah = new double[nrf];
-		if (b) delete[] b;
-		b = new double[nrf];
-		if (qeqi) delete[] qeqi;
-		qeqi = new double[nrf];
-		if (bmind) delete[] bmind;
-		bmind = new double[nrf];
-		if (bminv) delete[] bminv;
-		bminv = new double[nrf];
-		if (lmin) delete[] lmin;
-		lmin = new double[nrf];
-		if (qisq) delete[] qisq;
-		qisq = new double[nrf];
-		if (kmod) delete[] kmod;
-		kmod = new bool[nrf];
-
-		if (yft) delete[] yft;
-		yft = new double[nrf];
-		if (p) delete[] p;
-		p = new double[nrf];
-		if (sn2) delete[] sn2;
-		sn2 = new double[nrf];
-		if (pb) delete[] pb;
-		pb = new double[nrf];
-		if (pminu) delete[] pminu;
-		pminu = new double[nrf];
-		if (pb2) delete[] pb2;
-		pb2 = new double[nrf];
-		if (lminflag) delete[] lminflag;
-		lminflag = new bool[nrf];
-		if (actmin) delete[] actmin;
-		actmin = new double[nrf];
-		if (actminsub) delete[] actminsub;
-		actminsub = new double[nrf];
-
-		if (actbuf)
-		{
-			for (int i = 0; i < nu; ++i)
-			{
-				delete[] actbuf[i];
-			}
-			delete[] actbuf;
-		}
-		actbuf = new double*[nu];
+		// One allocation for every per-bin array, and the nu rows of actbuf after them
+		_nrf = nrf;
+		_arena.assign((NumArrays + nu) * nrf, 0);
 		for (int i = 0; i < nu; ++i)
 		{
-			actbuf[i] = new double[nrf];
-			for (int j = 0; j < nrf; ++j)
-			{
-				actbuf[i][j] = INT_MAX;
-			}
+			std::fill_n(actbufRow(i), nrf, std::numeric_limits<Real>::max());
 		}
 
-		MathUtil::computePowerSpectrum(spectrum, yft, nrf);
-		for (int i = 0; i < nrf; ++i)
+	}
+
+	Real * const yft = array(Yft);
+	Real * const p = array(P);
+	Real * const sn2 = array(Sn2);
+	Real * const pb = array(Pb);
+	Real * const pminu = array(Pminu);
+	Real * const pb2 = array(Pb2);
+	Real * const actmin = array(Actmin);
+	Real * const actminsub = array(Actminsub);
+	Real * const qeqi = array(Qeqi);
+	Real * const kmod = array(Kmod);
+	Real * const lminflag = array(Lminflag);
+
+	// Periodogram, and the sums over all the frequencies needed before the smoothing, in one pass
+	double sum_yft = 0, sum_p = 0, sum_sn2 = 0;
+	for (int i = 0; i < nrf; ++i)
+	{
+		const Real power = std::norm(spectrum[i]);
+		yft[i] = power;
+		if (reinit)
 		{
-			p[i] = yft[i];
-			sn2[i] = p[i];
-			pb[i] = p[i];
-			pminu[i] = p[i];
-			pb2[i] = p[i] * p[i];
+			p[i] = power;
+			sn2[i] = power;
+			pb[i] = power;
+			pminu[i] = power;
+			pb2[i] = power * power;
 			lminflag[i] = false;
-			actmin[i] = INT_MAX;
-			actminsub[i] = INT_MAX;
+			actmin[i] = std::numeric_limits<Real>::max();
+			actminsub[i] = std::numeric_limits<Real>::max();
 		}
+		sum_yft += power;
+		sum_p += p[i];
+		sum_sn2 += sn2[i];
 	}
-	else
-	{
-		MathUtil::computePowerSpectrum(spectrum, yft, nrf);
-		segment_number++;
-	}
-
+	++segment_number;
 
 
 	// Main processing
-	double acb = 1. / (1. + pow(accumulate(p, p + nrf, 0.) / accumulate(yft, yft + nrf, 0.) - 1., 2));  // alpha_c-bar(t)  (9)
+	const double acr = sum_p / sum_yft - 1.;
+	const double acb = 1. / (1. + acr * acr);  // alpha_c-bar(t)  (9)
 	ac = aca * ac + (1 - aca) * max(acb, acmax);      // alpha_c(t)  (10)
-	for (int i = 0; i < nrf; ++i)
-	{
-		ah[i] = amax * ac * 1. / (1. + pow(p[i] / sn2[i] - 1., 2));    // alpha_hat: smoothing factor per frequency (11)
-	}
-	double snr = accumulate(p, p + nrf, 0.) / accumulate(sn2, sn2 + nrf, 0.);
 
-	double localmin = min(aminh, pow(snr, snrexp));
+	// Constants of the per-bin loops, in the precision of the arrays
+	const Real ahmax = (Real) (amax * ac);
+	const Real localmin = (Real) min(aminh, pow(sum_p / sum_sn2, snrexp));
+	const Real bmaxr = (Real) bmax;
+	const Real qeqimaxr = (Real) qeqimax;
+	const Real qeqimin_t = (Real) (qeqimin / segment_number);
+
+	double sum_qeqi = 0;
 	for (int i = 0; i < nrf; ++i)
 	{
-		ah[i] = max(ah[i], localmin);       // lower limit for alpha_hat (12)
-		p[i] = ah[i] * p[i] + (1 - ah[i]) * yft[i];            // smoothed noisy speech power (3)
-
-		b[i] = min(pow(ah[i], 2.), bmax);              // smoothing constant for estimating periodogram variance (22 + 2 lines)
-		pb[i] = b[i] * pb[i] + (1 - b[i]) * p[i];            // smoothed periodogram (20)
-		pb2[i] = b[i] * pb2[i] + (1 - b[i]) * pow(p[i], 2);     // smoothed periodogram squared (21)
-
-		qeqi[i] = max(min((pb2[i] - pow(pb[i], 2.)) / (2 * pow(sn2[i], 2.)), qeqimax), qeqimin / segment_number); // Qeq inverse (23)
+		const Real r = p[i] / sn2[i] - 1;
+		const Real ah = max(ahmax / (1 + r * r), localmin);    // alpha_hat: smoothing factor per frequency (11), lower limit (12)
+		const Real pi = ah * p[i] + (1 - ah) * yft[i];            // smoothed noisy speech power (3)
+		p[i] = pi;
+
+		const Real b = min(ah * ah, bmaxr);              // smoothing constant for estimating periodogram variance (22 + 2 lines)
+		const Real pbi = b * pb[i] + (1 - b) * pi;            // smoothed periodogram (20)
+		const Real pb2i = b * pb2[i] + (1 - b) * pi * pi;     // smoothed periodogram squared (21)
+		pb[i] = pbi;
+		pb2[i] = pb2i;
+
+		const Real q = max(min((pb2i - pbi * pbi) / (2 * sn2[i] * sn2[i]), qeqimaxr), qeqimin_t); // Qeq inverse (23)
+		qeqi[i] = q;
+		sum_qeqi += q;
 	}
 
-	double qiav = accumulate(qeqi, qeqi + nrf, 0) / nrf;             // Average over all frequencies (23+12 lines) (ignore non-duplication of DC and nyquist terms)
-	double bc = 1. + qq.av * sqrt(qiav);             // bias correction factor (23+11 lines)
+	const double qiav = sum_qeqi / nrf;             // Average over all frequencies (23+12 lines) (ignore non-duplication of DC and nyquist terms)
+	const Real bc = (Real) (1. + qq.av * sqrt(qiav));             // bias correction factor (23+11 lines)
+	const Real cd = (Real) (2. * (nd - 1.) * (1. - md));
+	const Real cv = (Real) (2. * (nv - 1.) * (1. - mv));
+	const Real md2 = (Real) (2. * md);
+	const Real mv2 = (Real) (2. * mv);
+	const bool middle = subwc > 0 && subwc < nv;  // middle of buffer - allow a local minimum
 	for (int i = 0; i < nrf; ++i)
 	{
-		bmind[i] = 1. + 2. * (nd - 1.) * (1. - md) / (1. / qeqi[i] - 2. * md);      // we use the simplified form (17) instead of (15)
-		bminv[i] = 1. + 2. * (nv - 1.) * (1. - mv) / (1. / qeqi[i] - 2. * mv);      // same expression but for sub windows
-
-		kmod[i] = bc * p[i] * bmind[i] < actmin[i];        // Frequency mask for new minimum
-
-		if (kmod[i])
-		{
-			actmin[i] = bc * p[i] * bmind[i];
-			actminsub[i] = bc * p[i] * bminv[i];
-		}
-	}
+		const Real bcp = bc * p[i];
+		const Real bmind = 1 + cd / (1 / qeqi[i] - md2);      // we use the simplified form (17) instead of (15)
+		const Real bminv = 1 + cv / (1 / qeqi[i] - mv2);      // same expression but for sub windows
 
+		const bool k = bcp * bmind < actmin[i];        // Frequency mask for new minimum
+		kmod[i] = k;
+		actmin[i] = k ? bcp * bmind : actmin[i];
+		actminsub[i] = k ? bcp * bminv : actminsub[i];
 
-	if (subwc > 0 && subwc < nv)             // middle of buffer - allow a local minimum
-	{
-		for (int i = 0; i < nrf; ++i)
+		if (middle)
 		{
-			lminflag[i] |= kmod[i];     // potential local minimum frequency bins
+			lminflag[i] = lminflag[i] || k;     // potential local minimum frequency bins
 			pminu[i] = min(actminsub[i], pminu[i]);
 			sn2[i] = pminu[i];
 		}
+		x[i] = sn2[i];
 	}
-	else if (subwc >= nv)                    // end of buffer - do a buffer switch
+
+	if (subwc >= nv)                    // end of buffer - do a buffer switch
 	{
-		ibuf = ibuf % nu;       // increment actbuf storage pointer
-		for (int i = 0; i < nrf; ++i)
-		{
-			actbuf[ibuf][i] = actmin[i];        // save sub-window minimum
-		}
-		// attention, boucle inverse à l'ordre normal de la matrice (on raisonne en "colonnes")
-		for (int i = 0; i < nrf; ++i)
-		{
-			double tmp = 1;
-			for (int j = 0; j < nu; ++j)
-			{
-				tmp = min(tmp, actbuf[j][i]);
-			}
-			pminu[i] = tmp;
-		}
+		// actbuf is a contiguous [nu][nrf] block: the minimum over the sub-windows is a column-wise reduction
+		std::copy(actmin, actmin + nrf, actbufRow(ibuf));        // save sub-window minimum
+		ibuf = (ibuf + 1) % nu;       // increment actbuf storage pointer
+		MathUtil::columnMinimum(actbufRow(0), (unsigned int) nu, pminu, (unsigned int) nrf);
 
-		int tmp_index = -1;
+		int tmp_index = 3;
 		for (int i = 0; i < 4; ++i)
 		{
 			if (qiav < qq.qith[i])
@@ -289,40 +197,32 @@ void MartinEstimation::algo(std::complex<double> *spectrum, int nrf, double *x,
 			}
 		}
 
-		double nsm = nsms[tmp_index];           // noise slope max
+		const Real nsm = (Real) nsms[tmp_index];           // noise slope max
 		for (int i = 0; i < nrf; ++i)
 		{
-			lmin[i] = lminflag[i] && !kmod && actminsub[i] < nsm * pminu[i] && actminsub[i] > pminu[i];
+			const bool lmin = lminflag[i] && !kmod[i] && actminsub[i] < nsm * pminu[i] && actminsub[i] > pminu[i];
 
-			if (lmin[i])
+			if (lmin)
 			{
 				pminu[i] = actminsub[i];
 				for (int j = 0; j < nu; ++j)
 				{
-					actbuf[j][i] = pminu[i];
+					actbufRow(j)[i] = pminu[i];
 				}
 			}
 
 			lminflag[i] = 0;
-			actmin[i] = INT_MAX;
+			actmin[i] = std::numeric_limits<Real>::max();
 		}
 		subwc = 0;
 	}
 	++subwc;
-
-	for (int i = 0; i < nrf; ++i)
-	{
-		x[i] = sn2[i];
-		qisq[i] = sqrt(qeqi[i]);
-
-		// xs[t][i] = sn2[i] * sqrt(0.266 * (nd + 100 * qisq[i]) * qisq[i] / (1. + 0.005 * nd + 6. / nd) / (0.5 * 1 / qeqi[i] + nd - 1));
-	}
 }
 
 
 void MartinEstimation::mh_values(double d, double *m, double *h)
 {
-	static double dmh[3][18] =
+	static const double dmh[3][18] =
 	{
 		{1, 2, 5, 8, 10, 15, 20, 30, 40, 60, 80, 120, 140, 160, 180, 220, 260, 300},
 		{0, .26, .48, .58, .61, .668, .705, .762, .8, .841, .865, .89, .9, .91, .92, .93, .935, .94},
@@ -367,8 +267,6 @@ MartinEstimation::MartinEstimation(SubtractionManager& configuration):
 
 MartinEstimation::~MartinEstimation()
 {
-	algo(nullptr, 0, nullptr, 0, false, true);
-	return;
 }
 
 Estimation *MartinEstimation::clone()
@@ -378,9 +276,9 @@ Estimation *MartinEstimation::clone()
 
 
 
-bool MartinEstimation::operator()(std::complex<double> *input_spectrum)
+bool MartinEstimation::operator()(std::complex<Real> *input_spectrum)
 {
-	algo(input_spectrum,  conf.spectrumSize(), noise_power, ((double) conf.getFrameIncrement()) / ((double) conf.getSamplingRate()), _reinit, false);
+	algo(input_spectrum,  conf.spectrumSize(), noise_power, ((double) conf.getFrameIncrement()) / ((double) conf.getSamplingRate()), _reinit);
 	_reinit = false;
 	return true;
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <vector>
 #include "estimation_algorithm.h"
 
 
@@ -25,14 +26,14 @@ class MartinEstimation: public Estimation
 		MartinEstimation(SubtractionManager& configuration);
 		virtual ~MartinEstimation();
 		virtual Estimation* clone() override;
-		virtual bool operator()(std::complex<double>* input_spectrum);
+		virtual bool operator()(std::complex<Real>* input_spectrum);
 
 	protected:
 		virtual void specific_onFFTSizeUpdate();
 		virtual void specific_onDataUpdate();
 
 	private:
-		void algo(std::complex<double> *spectrum, int nrf, double *x, double tinc, bool reinit, bool lastcall);
+		void algo(std::complex<Real> *spectrum, int nrf, Real *x, double tinc, bool reinit);
 		static void mh_values(double d, double *m, double *h);
 
 		bool _reinit = false;
@@ -56,4 +57,52 @@ class MartinEstimation: public Estimation
 			double qith[4];
 			double nsmdb[4];
 		};
+
+		/**
+		 * @brief Per-bin arrays of the algorithm.
+		 *
+		 * They are stored one after the other in _arena, followed by the nu rows of actbuf.
+		 */
+		enum MartinArray
+		{
+			Yft, P, Sn2, Pb, Pminu, Pb2, Actmin, Actminsub,
+			Qeqi, Kmod, Lminflag,
+			NumArrays
+		};
+
+		/**
+		 * @brief Returns one of the per-bin arrays.
+		 * @param a Array.
+		 * @return Pointer to nrf values.
+		 */
+		Real *array(const MartinArray a);
+
+		/**
+		 * @brief Returns a row of actbuf, the minimum of each sub-window.
+		 * @param row Row, from 0 to nu.
+		 * @return Pointer to nrf values.
+		 */
+		Real *actbufRow(const int row);
+
+		std::vector<Real> _arena = std::vector<Real>(); /**< Single allocation for all the arrays */
+		int _nrf = 0; /**< Number of bins */
+
+		MartinNoiseParams qq = MartinNoiseParams();
+
+		int subwc = 0;
+		int segment_number = 0;
+		int nu = 0;
+		int ibuf = 0;
+		double ac = 0;
+		double aca = 0;
+		double acmax = 0;
+		double amax = 0;
+		double aminh = 0;
+		double bmax = 0;
+		double snrexp = 0;
+		double nv = 0, nd = 0;
+		double md = 0, hd = 0, mv = 0, hv = 0;
+		double qeqimax = 0;
+		double qeqimin = 0;
+		double nsms[4] = {0, 0, 0, 0};
 };
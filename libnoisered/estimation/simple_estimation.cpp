@@ -20,7 +20,7 @@ Estimation *SimpleEstimation::clone()
 	return new SimpleEstimation(*this);
 }
 
-bool SimpleEstimation::operator()(std::complex<double> *input_spectrum)
+bool SimpleEstimation::operator()(std::complex<Real> *input_spectrum)
 {
 	if (updateNoise(input_spectrum))
 	{
@@ -40,7 +40,7 @@ void SimpleEstimation::specific_onFFTSizeUpdate()
 
 }
 
-bool SimpleEstimation::updateNoise(const std::complex<double> * const in)
+bool SimpleEstimation::updateNoise(const std::complex<Real> * const in)
 {
 	// We estimate the RMS power and compare it to previous noise power
 	double current_rms = std::sqrt(MathUtil::mapReduce_n(in, conf.spectrumSize(), 0.0, MathUtil::CplxToPower, std::plus<double>()) / conf.spectrumSize());
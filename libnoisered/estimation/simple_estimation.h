@@ -12,7 +12,7 @@ class SimpleEstimation : public Estimation
 		SimpleEstimation(SubtractionManager& configuration);
 		virtual ~SimpleEstimation();
 		virtual Estimation* clone() override;
-		virtual bool operator()(std::complex<double>* input_spectrum);
+		virtual bool operator()(std::complex<Real>* input_spectrum);
 
 	protected:
 		virtual void specific_onDataUpdate();
@@ -30,7 +30,7 @@ class SimpleEstimation : public Estimation
 		 * @param old_rms Previous RMS value.
 		 * @return bool True if the noise power estimation changed.
 		 */
-		bool updateNoise(const std::complex<double> * const in);
+		bool updateNoise(const std::complex<Real> * const in);
 		double noise_rms = 100000;
 
 };
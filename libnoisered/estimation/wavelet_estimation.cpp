@@ -1,33 +1,41 @@
 #include <algorithm>
 
 #include "wavelet_estimation.h"
-#include "simple_estimation.h"
-#include "../subtraction/subtraction_algorithm.h"
 #include "subtraction_manager.h"
 
 
 
 WaveletEstimation::WaveletEstimation(SubtractionManager &configuration):
-	Estimation(configuration)
+	Estimation(configuration),
+	simple_estimation(configuration)
 {
 	cwt_noise_estimator.initialize(conf);
 }
 
 WaveletEstimation::WaveletEstimation(const WaveletEstimation &we):
-	Estimation(we.conf)
+	Estimation(we),
+	simple_estimation(we.simple_estimation),
+	cwt_noise_estimator(we.cwt_noise_estimator),
+	noise_frame(we.noise_frame),
+	compute_max(we.compute_max),
+	tones_found(we.tones_found)
 {
-	onFFTSizeUpdate();
-	std::copy_n(we.noise_power_reest, conf.spectrumSize(), noise_power_reest); /**< TODO */
-	std::copy_n(we.tmp_spectrum, conf.spectrumSize(), tmp_spectrum);
-	std::copy_n(we.tmp_out, conf.FFTSize(), tmp_out);
+	noise_power_reest = new Real[conf.FFTSize()];
+	std::copy_n(we.noise_power_reest, conf.FFTSize(), noise_power_reest); /**< TODO */
 }
 
 const WaveletEstimation &WaveletEstimation::operator=(const WaveletEstimation &we)
 {
-	onFFTSizeUpdate();
-	std::copy_n(we.noise_power_reest, conf.spectrumSize(), noise_power_reest); /**< TODO */
-	std::copy_n(we.tmp_spectrum, conf.spectrumSize(), tmp_spectrum);
-	std::copy_n(we.tmp_out, conf.FFTSize(), tmp_out);
+	Estimation::operator=(we);
+	simple_estimation = we.simple_estimation;
+	cwt_noise_estimator = we.cwt_noise_estimator;
+	noise_frame = we.noise_frame;
+	compute_max = we.compute_max;
+	tones_found = we.tones_found;
+
+	delete[] noise_power_reest;
+	noise_power_reest = new Real[conf.FFTSize()];
+	std::copy_n(we.noise_power_reest, conf.FFTSize(), noise_power_reest); /**< TODO */
 
 	return *this;
 }
@@ -35,9 +43,6 @@ const WaveletEstimation &WaveletEstimation::operator=(const WaveletEstimation &w
 WaveletEstimation::~WaveletEstimation()
 {
 	delete[] noise_power_reest;
-	fftw_free(tmp_out);
-	fftw_free(tmp_spectrum);
-	fftw_destroy_plan(plan_bw_temp);
 }
 
 Estimation *WaveletEstimation::clone()
@@ -45,63 +50,88 @@ Estimation *WaveletEstimation::clone()
 	return new WaveletEstimation(*this);
 }
 
-bool WaveletEstimation::operator()(std::complex<double> *input_spectrum)
+bool WaveletEstimation::operator()(std::complex<Real> *input_spectrum)
 {
-	bool reinit = true; //TODO be CAREFUL
-	static bool computeMax = false;
-	if (reinit) computeMax = false;
-	SimpleEstimation simpleEstimation(conf); // Make local ?
-	simpleEstimation.onFFTSizeUpdate();
-
-	bool reestimated = simpleEstimation(input_spectrum);
-
-	// 1° copy noise_power into noise_power_reest
-	std::copy_n(noise_power, conf.spectrumSize(), noise_power_reest);
+	noise_frame = simple_estimation(input_spectrum);
+	std::copy_n(simple_estimation.noisePower(), conf.spectrumSize(), noise_power_reest);
 
-	if (!reestimated)
+	if (noise_frame)
 	{
-		std::copy_n(input_spectrum, conf.spectrumSize(), tmp_spectrum);
-
-		(*conf.getSubtractionImplementation())(input_spectrum, noise_power_reest);
-
-		fftw_execute(plan_bw_temp);
-
-		// 3° Compute CWT and reestimate noise
-		cwt_noise_estimator.estimate(tmp_out, noise_power_reest, computeMax);
-		computeMax = false;
+		// Compute the max. of the next output
+		compute_max = true;
 	}
-	else
+	else if (tones_found)
 	{
-		// Compute the max. of the frame
-		computeMax = true;
+		// Musical tones of the previous output
+		cwt_noise_estimator.reestimateNoise(noise_power_reest);
 	}
+	tones_found = false;
 
-	return reestimated;
+	return noise_frame;
+}
+
+void WaveletEstimation::onFrameOutput(const Real *gain, const Real *output)
+{
+	if (noise_frame) return;
+
+	// The manager's output: no second subtraction nor backward FFT
+	cwt_noise_estimator.selectBands(gain);
+	cwt_noise_estimator.detect(output, compute_max);
+	compute_max = false;
+	tones_found = true;
+}
+
+bool WaveletEstimation::usesFrameOutput() const
+{
+	return true;
 }
 
 // prepare: quand on change de fftsize par exemple
 void WaveletEstimation::specific_onFFTSizeUpdate()
 {
 	delete[] noise_power_reest;
-	if(tmp_out) fftw_free(tmp_out);
-	if(tmp_spectrum) fftw_free(tmp_spectrum);
-	if(plan_bw_temp) fftw_destroy_plan(plan_bw_temp);
 
-	noise_power_reest = new double[conf.FFTSize()];
+	noise_power_reest = new Real[conf.FFTSize()];
+	std::fill_n(noise_power_reest, conf.FFTSize(), 0);
 
-	tmp_out = fftw_alloc_real(conf.FFTSize());
-	tmp_spectrum = reinterpret_cast<std::complex<double>*>(fftw_alloc_complex(conf.spectrumSize()));
-	plan_bw_temp = fftw_plan_dft_c2r_1d(conf.FFTSize(), reinterpret_cast<fftw_complex*>(tmp_spectrum), tmp_out, FFTW_ESTIMATE);
+	cwt_noise_estimator.initialize(conf);
 }
 
-double *WaveletEstimation::noisePower()
+Real *WaveletEstimation::noisePower()
 {
 	return noise_power_reest;
 }
 
+unsigned int WaveletEstimation::scaleCount() const
+{
+	return cwt_noise_estimator.scaleCount();
+}
 
-void WaveletEstimation::specific_onDataUpdate()
+void WaveletEstimation::setScaleCount(const unsigned int value)
 {
+	cwt_noise_estimator.setScaleCount(value);
+	cwt_noise_estimator.initialize(conf);
+}
 
+bool WaveletEstimation::isBandLimited() const
+{
+	return cwt_noise_estimator.isBandLimited();
 }
 
+void WaveletEstimation::setBandLimited(const bool value, const unsigned int decimation)
+{
+	cwt_noise_estimator.setBandLimited(value);
+	cwt_noise_estimator.setDecimation(decimation);
+	cwt_noise_estimator.initialize(conf);
+}
+
+
+void WaveletEstimation::specific_onDataUpdate()
+{
+	// Also resizes its buffer: this is called before specific_onFFTSizeUpdate() when the FFT size changes
+	simple_estimation.onFFTSizeUpdate();
+
+	noise_frame = true;
+	compute_max = true;
+	tones_found = false;
+}
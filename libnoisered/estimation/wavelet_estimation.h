@@ -1,12 +1,17 @@
 #pragma once
-#include <fftw3.h>
-
 #include "estimation_algorithm.h"
+#include "simple_estimation.h"
 #include "wavelets/cwt_noise_estimator.h"
 /**
  * @brief The WaveletEstimation class
  *
- * Wavelet estimation algorithm.
+ * Wavelet estimation algorithm: the simple estimation, lowered on the bins
+ * of the musical tones found in the wavelet transform of the output.
+ *
+ * The musical tones are found in the output of each frame given by the manager
+ * (onFrameOutput()), after its subtraction and backward FFT, and the noise of the
+ * next frame is lowered accordingly. Nothing is done after a frame of noise, on
+ * which the simple estimation is updated.
  */
 class WaveletEstimation : public Estimation
 {
@@ -17,25 +22,60 @@ class WaveletEstimation : public Estimation
 
 		virtual ~WaveletEstimation();
 		virtual Estimation* clone() override;
-		virtual bool operator()(std::complex<double>* input_spectrum);
+		virtual bool operator()(std::complex<Real>* input_spectrum);
+
+		virtual Real *noisePower();
+
+		virtual void onFrameOutput(const Real* gain, const Real* output) override;
+		virtual bool usesFrameOutput() const override;
 
-		virtual double *noisePower();
+		/**
+		 * @brief Number of scales of the wavelet transform.
+		 *
+		 * @return unsigned int Scale count.
+		 */
+		unsigned int scaleCount() const;
+
+		/**
+		 * @brief Sets the number of scales of the wavelet transform, between AMIN and AMAX.
+		 *
+		 * The default, 1280, is a step of ASTP. Fewer scales make the transform cheaper.
+		 *
+		 * @param value Scale count.
+		 */
+		void setScaleCount(const unsigned int value);
+
+		/**
+		 * @brief Tells if the wavelet transform is band-limited.
+		 *
+		 * @return bool True in band-limited mode.
+		 */
+		bool isBandLimited() const;
+
+		/**
+		 * @brief Computes the wavelet transform only on the bins attenuated by the subtraction,
+		 * with one scale per bin and one column every decimation samples.
+		 *
+		 * Much cheaper. The bins of the musical tones found are the same, within one bin or one scale
+		 * step of the full transform (several bins above bin 90 at FFT size 512), with nearly the same power.
+		 *
+		 * @param value True for the band-limited mode.
+		 * @param decimation Samples per column.
+		 */
+		void setBandLimited(const bool value, const unsigned int decimation = 4);
 
 	protected:
 		virtual void specific_onFFTSizeUpdate();
 		virtual void specific_onDataUpdate();
 
 	private:
-		double cwt_amin = 0;
-		double cwt_astp = 0.05;
-		double cwt_amax = 64;
-
+		SimpleEstimation simple_estimation; /**< Estimation before the reestimation */
 		CWTNoiseEstimator cwt_noise_estimator = CWTNoiseEstimator(); /**< TODO */
 
-		double *noise_power_reest = nullptr; /**< TODO */
+		Real *noise_power_reest = nullptr; /**< TODO */
 
-		fftw_plan plan_bw_temp = nullptr; /**< TODO */
-		std::complex<double> *tmp_spectrum = nullptr; /**< TODO */
-		double *tmp_out = nullptr; /**< TODO */
+		bool noise_frame = true; /**< The simple estimation was updated on the last frame */
+		bool compute_max = true; /**< The maximum of the scalogram has to be computed on the next output */
+		bool tones_found = false; /**< The musical tones of the last output are ready for the next frame */
 
 };
@@ -1,133 +1,58 @@
+#include <algorithm>
 #include <cmath>
-#include <climits>
 #include <iostream>
 
 #include "area.h"
-Area::Area():
-	minHeight(INT_MAX)
+Area::Area()
 {
 }
 
-void Area::removeArea(MaskedMatrix &m)
+void Area::addRun(const MaskedMatrix::size_type i, const MaskedMatrix::size_type first, const MaskedMatrix::size_type last,
+				  const double sum, const double max, const MaskedMatrix::size_type max_row)
 {
-	for (auto i = x0; i < x0 + length; ++i)
+	if (numPixels == 0)
 	{
-		for (auto j = pairList[i - x0]._x - 1; j < pairList[i - x0]._y + 1; ++j)
-		{
-			m[i][j] = 0;
-			m.unmask(i, j);
-		}
+		x0 = x1 = i;
+		minHeight = first;
+		maxHeight = last;
 	}
-}
-
-void Area::plotArea(MaskedMatrix &m)
-{
-	std::cout << "x0 " << x0 << "   length " << length << std::endl;
-	for (auto i = 0U; i < m.size(); ++i)
+	else
 	{
-		for (auto j = 0U; j < m[i].size(); ++j)
-		{
-			if (i >= x0 &&
-				(i < (x0 + length)) &&
-				(j >= pairList[i - x0]._x) &&
-				(j < pairList[i - x0]._y))
-			{
-				m.mask(i, j);
-			}
-			else
-			{
-				m[i][j] = 0; //TODO might erase surroundings ?
-			}
-		}
+		x0 = std::min(x0, i);
+		x1 = std::max(x1, i);
+		minHeight = std::min(minHeight, first);
+		maxHeight = std::max(maxHeight, last);
 	}
-}
-
-void Area::plotContour(MaskedMatrix &m, MaskedMatrix::size_type i, MaskedMatrix::size_type j)
-{
-	auto i_orig = i, j_orig = j;
 
-	x0 = i;
-	Point<MaskedMatrix::size_type> p;
-
-	auto add_point = [&]()
-	{
-		i = p._x;
-		j = p._y;
-		if (i >= x0 + length)
-		{
-			pairList.push_back(Pair<MaskedMatrix::size_type>(j, j));
-			++length;
-		}
-		else
-		{
-			if (j < pairList[i - x0]._x)
-			{
-				pairList[i - x0]._x = j;
-			}
-			else if (j > pairList[i - x0]._y)
-			{
-				pairList[i - x0]._y = j;
-			}
-		}
-	};
-
-	for (auto k = 0U; k < 2U; ++k)
+	const auto count = last - first + 1;
+	numPixels += (unsigned int) count;
+	sumOfValues += sum;
+	sumOfHeights += double(first + last) * double(count) / 2;
+	if (max_pt.val < max)
 	{
-		while (!m.isMasked(i, j))
-		{
-			m.mask(i, j);
-			p = m.next_adjacent_to_zero(i, j, x0);
-			if (p.notValid()) break;
-			add_point();
-		}
-
-		i = i_orig;
-		j = j_orig;
-		p = m.next_adjacent_to_zero(i, j, x0);
-		if (p.notValid()) break;
-		add_point();
+		max_pt.val = max;
+		max_pt._x = i;
+		max_pt._y = max_row;
 	}
-	m.mask(i_orig, j_orig);
-}
-
-void Area::computeParameters(MaskedMatrix &m)
-{
-	for (auto i = x0 + 1; i < x0 + length - 1; ++i)
-	{
-		for (auto j = pairList[i - x0]._x + 1; j < pairList[i - x0]._y - 1; ++j)
-		{
-			numPixels++;
-			sumOfValues += m[i][j];
-			if (max_pt.val < m[i][j])
-			{
-				max_pt.val = m[i][j];
-				max_pt._x = i;
-				max_pt._y = j;
-			}
-		}
-		medianHeight += (pairList[i - x0]._x + pairList[i - x0]._y) / 2;
-		if (pairList[i - x0]._x < minHeight) minHeight = pairList[i - x0]._x;
-		if (pairList[i - x0]._y > maxHeight) maxHeight = pairList[i - x0]._y;
-	}
-	medianHeight /= length;
 }
 
 void Area::printParameters()
 {
 	std::cout << "Parameters of the area" << std::endl;
-	std::cout << "Beginning:\t" << x0 << "\t\tLength: " << length << "\tHeight: " << verticalSize() << std::endl;
+	std::cout << "Beginning:\t" << x0 << "\t\tLength: " << getWidth() << "\tHeight: " << verticalSize() << std::endl;
 	std::cout << "Mean:\t\t" << sumOfValues / numPixels << "\t\tMedian pxl: " << getMedianHeight() << std::endl;
 	std::cout << "Max:  Val: " << max_pt.val << "\t\t (x, y) : (" << max_pt._x << ", " << max_pt._y << ")" << std::endl;
 }
 
 MaskedMatrix::size_type Area::getMedianHeight()
 {
-	return medianHeight - 2; // we cover for the 2 pixels displacement
+	// The row is the scale: the padding rows are part of the matrix, there is no displacement to remove
+	return (MaskedMatrix::size_type) std::lround(sumOfHeights / numPixels);
 }
 
 MaskedMatrix::size_type Area::getWidth() const
 {
-	return length;
+	return numPixels == 0 ? 0 : x1 - x0 + 1;
 }
 
 double Area::getSumOfValues() const
@@ -149,3 +74,13 @@ MaskedMatrix::size_type Area::verticalSize()
 {
 	return maxHeight - minHeight;
 }
+
+MaskedMatrix::size_type Area::getMinHeight() const
+{
+	return minHeight;
+}
+
+MaskedMatrix::size_type Area::getMaxHeight() const
+{
+	return maxHeight;
+}
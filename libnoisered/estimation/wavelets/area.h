@@ -3,11 +3,9 @@
 
 /**
  * @brief Represents an area in a Matrix. Used for CWT MT reduction algorithm.
- * The area is delimited by a vertical pair of points. (i.e. lowest and highest point at a given column).
+ * The area is a connected set of masked pixels (8-connectivity).
  *
- * It is written in the matrix mask.
- *
- * For every function, the m parameter corresponds to the matrix the area is linked to.
+ * It is built by AreaLabeller, one vertical run of pixels at a time.
  *
  */
 class Area
@@ -15,65 +13,53 @@ class Area
 	public:
 		/**
 		 * @brief Constructor.
-		 *
-		 * @param m Matrix on which this area applies.
 		 */
 		Area();
 
 		/**
-		 * @brief Removes the area from the mask.
-		 *
-		 * @param m
-		 */
-		void removeArea(MaskedMatrix &m);
-
-		/**
-		 * @brief Fills the area on the mask.
+		 * @brief Adds a vertical run of pixels to the area.
 		 *
-		 * Used for debug purposes.
-		 *
-		 * @param m
+		 * @param i Column.
+		 * @param first First row.
+		 * @param last Last row.
+		 * @param sum Sum of the values of the run.
+		 * @param max Biggest value of the run.
+		 * @param max_row Row of the biggest value.
 		 */
-		void plotArea(MaskedMatrix &m);
+		void addRun(const MaskedMatrix::size_type i, const MaskedMatrix::size_type first, const MaskedMatrix::size_type last,
+					const double sum, const double max, const MaskedMatrix::size_type max_row);
 
 		/**
-		 * @brief Detects and plots the contour of the area on the mask of the matrix.
-		 *
-		 * This function is called when searching for areas after applying a ceiling operation.
-		 * Every time a non-zero pixel is found, it is called and plots the countour of the corresponding area.
+		 * @brief Prints the parameters to stdout.
 		 *
-		 * @param m
-		 * @param i Column.
-		 * @param j Line.
 		 */
-		void plotContour(MaskedMatrix &m, MaskedMatrix::size_type i, MaskedMatrix::size_type j);
+		void printParameters();
 
 		/**
-		 * @brief Computes useful parameters from the values in the matrix.
-		 *
-		 * Computes : number of pixels, median pixel, sum of values.
+		 * @brief Returns the biggest vertical size of the area.
 		 *
-		 * @param m
+		 * @return int Biggest height.
 		 */
-		void computeParameters(MaskedMatrix &m);
+		MaskedMatrix::size_type verticalSize();
 
 		/**
-		 * @brief Prints the parameters to stdout.
+		 * @brief Returns the lowest row of the area.
 		 *
+		 * @return size_type Row.
 		 */
-		void printParameters();
+		MaskedMatrix::size_type getMinHeight() const;
 
 		/**
-		 * @brief Returns the biggest vertical size of the area.
+		 * @brief Returns the highest row of the area.
 		 *
-		 * @return int Biggest height.
+		 * @return size_type Row.
 		 */
-		MaskedMatrix::size_type verticalSize();
+		MaskedMatrix::size_type getMaxHeight() const;
 
 		/**
-		 * @brief Returns the median height pixel.
+		 * @brief Returns the mean height of the pixels.
 		 *
-		 * @return int Median height.
+		 * @return int Mean row, which is the scale in the scalogram.
 		 */
 		MaskedMatrix::size_type getMedianHeight();
 
@@ -109,14 +95,13 @@ class Area
 
 	private:
 		Point<MaskedMatrix::size_type> max_pt = Point<MaskedMatrix::size_type>(); /**< TODO */
-		MaskedMatrix::size_type minHeight = 0; /**< TODO */
-		MaskedMatrix::size_type maxHeight = 0; /**< TODO */
-		MaskedMatrix::size_type x0 = 0; /**< TODO */
-		MaskedMatrix::size_type length = 0; /**< TODO */
-		std::vector<Pair<MaskedMatrix::size_type>> pairList = std::vector<Pair<MaskedMatrix::size_type>>(); /**< TODO */
+		MaskedMatrix::size_type minHeight = 0; /**< Lowest row */
+		MaskedMatrix::size_type maxHeight = 0; /**< Highest row */
+		MaskedMatrix::size_type x0 = 0; /**< First column */
+		MaskedMatrix::size_type x1 = 0; /**< Last column */
 
 		double sumOfValues = 0; /**< TODO */
 		unsigned int numPixels = 0; /**< TODO */
 
-		MaskedMatrix::size_type medianHeight = 0; /**< TODO */
+		double sumOfHeights = 0; /**< Sum of the rows of the pixels */
 };
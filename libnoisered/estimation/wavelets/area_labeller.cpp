@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <limits>
+
+#include "area_labeller.h"
+
+namespace
+{
+	//! Index of the lowest set bit of a non-zero word.
+	inline unsigned int lowestBit(const std::uint64_t word)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return (unsigned int) index;
+#else
+		return (unsigned int) __builtin_ctzll(word);
+#endif
+	}
+
+	//! First row from j to end whose mask bit is set (or clear), end if there is none.
+	inline MaskedMatrix::size_type nextRow(const std::uint64_t * const bits, MaskedMatrix::size_type j,
+										   const MaskedMatrix::size_type end, const bool set)
+	{
+		if (j >= end) return end;
+
+		auto w = j / 64;
+		std::uint64_t word = (set ? bits[w] : ~bits[w]) & (~std::uint64_t(0) << (j % 64));
+		while (word == 0)
+		{
+			if (++w * 64 >= end) return end;
+			word = set ? bits[w] : ~bits[w];
+		}
+		return std::min(end, w * 64 + lowestBit(word));
+	}
+}
+
+AreaLabeller::AreaLabeller()
+{
+}
+
+void AreaLabeller::label(const MaskedMatrix &m,
+						 const MaskedMatrix::size_type col_begin, const MaskedMatrix::size_type col_end,
+						 const MaskedMatrix::size_type row_begin, const MaskedMatrix::size_type row_end,
+						 std::vector<Area> &areas)
+{
+	_runs.clear();
+	_parent.clear();
+	areas.clear();
+
+	// First pass: runs, their values, and the labels they connect
+	std::vector<Run>::size_type prev_begin = 0, prev_end = 0;
+	for (auto i = col_begin; i < col_end; ++i)
+	{
+		const auto col = m[i];
+		const auto bits = m.maskColumn(i);
+		const auto cur_begin = _runs.size();
+		auto p = prev_begin;
+
+		for (auto j = nextRow(bits, row_begin, row_end, true); j < row_end; j = nextRow(bits, j, row_end, true))
+		{
+			const auto end = nextRow(bits, j, row_end, false);
+
+			Run run{i, j, end - 1, 0, 0, j, (unsigned int) _parent.size()};
+			for (; j < end; ++j)
+			{
+				run.sum += col[j];
+				if (run.max < col[j])
+				{
+					run.max = col[j];
+					run.maxRow = j;
+				}
+			}
+			_parent.push_back(run.label);
+
+			// Runs of the previous column touching rows first - 1 to last + 1
+			while (p < prev_end && _runs[p].last + 1 < run.first) ++p;
+			for (auto q = p; q < prev_end && _runs[q].first <= run.last + 1; ++q)
+				merge(run.label, _runs[q].label);
+
+			_runs.push_back(run);
+		}
+
+		prev_begin = cur_begin;
+		prev_end = _runs.size();
+	}
+
+	// Second pass: accumulation of the runs into the area of their root
+	_area.assign(_parent.size(), std::numeric_limits<unsigned int>::max());
+	for (const Run& run : _runs)
+	{
+		const unsigned int root = find(run.label);
+		if (_area[root] == std::numeric_limits<unsigned int>::max())
+		{
+			_area[root] = (unsigned int) areas.size();
+			areas.push_back(Area());
+		}
+		areas[_area[root]].addRun(run.col, run.first, run.last, run.sum, run.max, run.maxRow);
+	}
+}
+
+unsigned int AreaLabeller::find(unsigned int label)
+{
+	while (_parent[label] != label)
+	{
+		_parent[label] = _parent[_parent[label]];
+		label = _parent[label];
+	}
+	return label;
+}
+
+void AreaLabeller::merge(const unsigned int a, const unsigned int b)
+{
+	const unsigned int ra = find(a), rb = find(b);
+	if (ra < rb) _parent[rb] = ra;
+	else if (rb < ra) _parent[ra] = rb;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include "area.h"
+
+/**
+ * @brief Finds the areas of masked pixels of a Matrix.
+ *
+ * Two-pass run-length labelling: each column is cut in vertical runs of masked pixels,
+ * found a mask word at a time, whose sum and maximum are computed while scanning, and each run is joined
+ * (union-find) to the runs of the previous column it touches, diagonals included.
+ * The runs are then added to the Area of their label.
+ *
+ * The buffers are kept between calls: once they reached their size, labelling
+ * a matrix does not allocate.
+ */
+class AreaLabeller
+{
+	public:
+		AreaLabeller();
+
+		/**
+		 * @brief Labels the pixels of a part of the matrix.
+		 *
+		 * @param m Matrix.
+		 * @param col_begin First column.
+		 * @param col_end Column after the last one.
+		 * @param row_begin First row.
+		 * @param row_end Row after the last one.
+		 * @param areas Output: one Area per connected set of masked pixels, ordered by first pixel.
+		 */
+		void label(const MaskedMatrix& m,
+				   const MaskedMatrix::size_type col_begin, const MaskedMatrix::size_type col_end,
+				   const MaskedMatrix::size_type row_begin, const MaskedMatrix::size_type row_end,
+				   std::vector<Area>& areas);
+
+	private:
+		/**
+		 * @brief Vertical run of masked pixels.
+		 */
+		struct Run
+		{
+			MaskedMatrix::size_type col;
+			MaskedMatrix::size_type first;
+			MaskedMatrix::size_type last;
+			double sum;
+			double max;
+			MaskedMatrix::size_type maxRow;
+			unsigned int label;
+		};
+
+		/**
+		 * @brief Root of a label, with path halving.
+		 *
+		 * @param label Label.
+		 * @return unsigned int Root label.
+		 */
+		unsigned int find(unsigned int label);
+
+		/**
+		 * @brief Merges two labels. The smallest root becomes the root of both.
+		 */
+		void merge(const unsigned int a, const unsigned int b);
+
+		std::vector<Run> _runs = std::vector<Run>();
+		std::vector<unsigned int> _parent = std::vector<unsigned int>(); /**< Union-find forest, one entry per run */
+		std::vector<unsigned int> _area = std::vector<unsigned int>(); /**< Index of the area of each root label */
+};
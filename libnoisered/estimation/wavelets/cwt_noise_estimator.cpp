@@ -1,68 +1,125 @@
-#include <functional>
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 
 #include "../../subtraction_manager.h"
 #include "cwt_noise_estimator.h"
 
+namespace
+{
+	//! Bins transformed on each side of an attenuated bin, in band-limited mode.
+	constexpr unsigned int band_margin = 2;
+}
 
+CWTNoiseEstimator::CWTNoiseEstimator()
+{
+}
 
-#define PLOT_CWT
+void CWTNoiseEstimator::initialize(SubtractionManager &config)
+{
+	const unsigned int fft_size = config.FFTSize();
+	const bool decimated = bandLimited && fft_size % decimationFactor == 0;
+	const MaskedMatrix::size_type rows = bandLimited ? config.spectrumSize() : scales;
+	const MaskedMatrix::size_type cols = decimated ? fft_size / decimationFactor : fft_size;
 
-CWTNoiseEstimator::CWTNoiseEstimator()
+	// Copies keep their scalogram and share the kernels of the transform
+	if (fftSize == fft_size && samplingRate == config.getSamplingRate() &&
+			initializedBandLimited == bandLimited && wtRows == rows && wtCols == cols)
+		return;
+
+	samplingRate = config.getSamplingRate();
+	spectrumSize = config.spectrumSize();
+	fftSize = fft_size;
+	freqPerBin = (samplingRate / 2.0) / spectrumSize;
+	initializedBandLimited = bandLimited;
+
+	areaParams = std::vector<CWTNoiseEstimator::areaParams_>(config.spectrumSize(), areaParams_());
+
+	if (bandLimited)
+	{
+		// One scale per bin, from the one of AMAX, and no padding
+		const auto first_bin = (unsigned int) std::ceil(MorletCWT::centerFrequency() * fftSize / AMAX);
+		cwt.initializeBins(fftSize, first_bin, 1.0 / fftSize, decimationFactor);
+
+		arr = MaskedMatrix(cols, rows);
+		arr.setRowPadding(first_bin);
+		bands.assign(1, std::make_pair(first_bin, (unsigned int) rows));
+	}
+	else
+	{
+		// The column t is the sample t and the row k the scale k. The padding is inside the matrix:
+		// the samples 0 and 1 and the scales 0 (a = 0) and 1 are neither computed nor labelled,
+		// as with the former layout of size + 4 columns, whose last 4 columns and rows were never written.
+		arr = MaskedMatrix(cols, rows);
+		arr.setColPadding(2);
+		arr.setRowPadding(2);
+		bands.assign(1, std::make_pair(2U, scales));
+
+		cwt.initialize(fftSize, (unsigned int) arr.getRowPadding(), scales, double(AMAX - AMIN) / scales, 1.0 / fftSize);
+	}
+	wtCols = cols;
+	wtRows = rows;
+}
+
+unsigned int CWTNoiseEstimator::scaleCount() const
 {
+	return scales;
 }
 
-CWTNoiseEstimator::CWTNoiseEstimator(const CWTNoiseEstimator & other):
-	areaParams(other.areaParams),
-	s(other.s),
-	wt(other.wt->clone()),
-	arr(other.arr),
-	areas(other.areas),
-	copyFromWT(new ArrayValueFilter([&](unsigned int i, unsigned int j) { arr[i][j] = wt->mag(j, i) / fftSize; }))
+void CWTNoiseEstimator::setScaleCount(const unsigned int value)
 {
+	scales = std::max(value, 3U);
 }
 
-const CWTNoiseEstimator &CWTNoiseEstimator::operator=(const CWTNoiseEstimator & other)
+bool CWTNoiseEstimator::isBandLimited() const
 {
-	s = other.s;
-	areaParams = other.areaParams;
-	arr = other.arr;
-	areas = other.areas;
-
-	wt = other.wt->clone();
-	copyFromWT = new ArrayValueFilter([&](unsigned int i, unsigned int j) { arr[i][j] = wt->mag(j, i) / fftSize; });
-	return *this;
+	return bandLimited;
 }
 
-CWTNoiseEstimator::~CWTNoiseEstimator()
+void CWTNoiseEstimator::setBandLimited(const bool value)
 {
-	delete wt;
-	delete copyFromWT;
+	bandLimited = value;
 }
 
-void CWTNoiseEstimator::initialize(SubtractionManager &config)
+unsigned int CWTNoiseEstimator::decimation() const
 {
-	samplingRate = config.getSamplingRate();
-	spectrumSize = config.spectrumSize();
-	fftSize = config.FFTSize();
+	return decimationFactor;
+}
 
-	areaParams = std::vector<CWTNoiseEstimator::areaParams_>(config.spectrumSize(), areaParams_());
-	s = Signal(config.FFTSize(), NULL, NULL, 1.0, "signal");
+void CWTNoiseEstimator::setDecimation(const unsigned int value)
+{
+	decimationFactor = std::max(value, 1U);
+}
+
+void CWTNoiseEstimator::selectBands(const Real *gain)
+{
+	if (!initializedBandLimited) return;
 
-	arr = MaskedMatrix(config.FFTSize() + 4, (AMAX - AMIN) / ASTP + 4);
-	copyFromWT = new ArrayValueFilter([&](unsigned int i, unsigned int j) { arr[i][j] = wt->mag(j, i) / fftSize; });
+	// Runs of attenuated bins, widened by a margin and merged
+	const auto first_bin = (unsigned int) arr.getRowPadding();
+	bands.clear();
+	for (auto b = first_bin; b < wtRows; ++b)
+	{
+		if (!(gain[b] < 1)) continue;
+
+		const unsigned int begin = std::max(first_bin, b - std::min(b, band_margin));
+		const unsigned int end = std::min((unsigned int) wtRows, b + band_margin + 1);
+		if (!bands.empty() && begin <= bands.back().second)
+			bands.back().second = end;
+		else
+			bands.emplace_back(begin, end);
+	}
 }
 
 void CWTNoiseEstimator::writeFiles(std::string dir, int file_no)
 {
 	std::ofstream file(std::string(dir + "/" + std::to_string(file_no) + ".dat"));
-	for (auto i = 0U; i < wt->rows() + 2; i++)
+	for (auto i = 0U; i < arr.rows(); i++)
 	{
-		for (auto j = 0U; j < wt->cols() + 2; j++)
+		for (auto j = 0U; j < arr.size(); j++)
 		{
-			std::string s_tmp = std::string(" " + std::to_string(arr[j][i]));
+			std::string s_tmp = std::string(" " + std::to_string(arr.isMasked(j, i) ? arr[j][i] : 0));
 			file.write(s_tmp.c_str(), s_tmp.length());
 		}
 		file.write(std::string("\n").c_str(), 1);
@@ -72,12 +129,11 @@ void CWTNoiseEstimator::writeFiles(std::string dir, int file_no)
 
 	QFile file(QString(dir) + QString("/%1.dat").arg(file_no));
 	file.open(QIODevice::WriteOnly);
-	for (auto i = 0U; i < wt->rows() + 2; i++)
+	for (auto i = 0U; i < arr.rows(); i++)
 	{
-		for (auto j = 0U; j < wt->cols() + 2; j++)
+		for (auto j = 0U; j < arr.size(); j++)
 		{
-			file.write(QString(" %1").arg(arr[j][i]).toLatin1().data());
-			//          file.write(QString(" %1").arg((arr.getMask())[j][i]).toLatin1().data());
+			file.write(QString(" %1").arg(arr.isMasked(j, i) ? arr[j][i] : 0).toLatin1().data());
 		}
 		file.write("\n");
 	}
@@ -86,83 +142,88 @@ void CWTNoiseEstimator::writeFiles(std::string dir, int file_no)
 }
 
 
-void CWTNoiseEstimator::computeCWT(double *signal)
+void CWTNoiseEstimator::computeCWT(const Real *signal)
 {
-	ReDataProxy data = s.reData();
+	cwt.transform(signal, arr, (unsigned int) arr.getColPadding(), bands);
+}
 
-	// remplir data
-	for (auto i = 0U; i < fftSize; ++i)
-	{
-		data[i] = signal[i];
-	}
+void CWTNoiseEstimator::computeAreas()
+{
+	labeller.label(arr, arr.getColPadding(), wtCols, arr.getRowPadding(), wtRows, areas);
 
-	wt = CWTalgorithm::cwtft(s, scales, ComplexMorlet(), "NOPE");
-	arr.setColPadding(2);
-	arr.setRowPadding(2);
+	// Limiting the width and the frequency span of an area
+	const auto samples_per_column = cwt.decimation();
+	areas.erase(std::remove_if(areas.begin(), areas.end(), [&](const Area& a)
+	{ return a.getWidth() * samples_per_column <= 1 || verticalSteps(a) >= 100; }), areas.end());
 }
 
-void CWTNoiseEstimator::computeAreas()
+double CWTNoiseEstimator::verticalSteps(const Area &area) const
+{
+	if (!initializedBandLimited)
+		return double(area.getMaxHeight() - area.getMinHeight());
+
+	// The row k is the scale centerFrequency() * fftSize / k
+	const double scale_of_bin = MorletCWT::centerFrequency() * fftSize;
+	const double step = double(AMAX - AMIN) / scales;
+	return scale_of_bin * (1.0 / double(area.getMinHeight()) - 1.0 / double(area.getMaxHeight())) / step;
+}
+
+unsigned long CWTNoiseEstimator::areaBin(const Area &area)
 {
-	areas.clear();
-	for (auto i = arr.getColPadding(); i < wt->cols(); ++i)
-		for (auto j = arr.getRowPadding(); j < wt->rows(); ++j)
-			if (arr[i][j] > 0)
+	if (!initializedBandLimited)
+		return std::min(spectrumSize - 1LU, getFFTBin(area.getMax()._y));
+
+	// The row is the bin, with the same lower limit as getFFTBin()
+	return std::max(10LU, std::min((unsigned long) area.getMax()._y, spectrumSize - 1LU));
+}
+
+template<typename... Filters>
+void CWTNoiseEstimator::applyToArr(Filters&&... funs)
+{
+	for (auto i = arr.getColPadding(); i < wtCols; ++i)
+	{
+		MaskedMatrix::value_type * const col = arr[i];
+		for (const auto& band : bands)
+		{
+			for (MaskedMatrix::size_type j = band.first; j < band.second; ++j)
 			{
-				if (arr.isMasked(i, j)) // already explored area
-				{
-					while (arr[i][++j] > 0); // need to find more efficient way, by using Area* and jumping
-				}
-				else
-				{
-					Area a;// = new Area();
-					a.plotContour(arr, i, j);
-					if (a.getWidth() > 1)
-					{
-						a.computeParameters(arr);
-						if (a.verticalSize() < 100) // Limiting the frequency span of an area
-						{
-							areas.push_back(a);
-						}
-						else
-						{
-							a.removeArea(arr);
-						}
-					}
-					else
-					{
-						a.removeArea(arr);
-					}
-				}
+				// Calls each function in order
+				const int call[] = {(funs(col, i, j), 0)...};
+				(void) call;
 			}
+		}
+	}
 }
 
-void CWTNoiseEstimator::estimate(double *signal_in, double *noise_power, bool computeMax)
+void CWTNoiseEstimator::estimate(const Real *signal_in, Real *noise_power, bool computeMax)
+{
+	detect(signal_in, computeMax);
+	reestimateNoise(noise_power);
+}
+
+void CWTNoiseEstimator::detect(const Real *signal_in, bool computeMax)
 {
-	static double maxi = 0, ceil = 0, upperceil = 1000; // Put them in config
 	if (computeMax) maxi = 0;
 
-	// Lambdas initialisation
-	ArrayValueFilter lowCeiling([&](unsigned int i, unsigned int j)
-	{ arr[i][j] = (arr[i][j] > ceil) ? arr[i][j] : 0; });
-	ArrayValueFilter dblCeiling([&](unsigned int i, unsigned int j)
-	{ arr[i][j] = (arr[i][j] > ceil) ? ((arr[i][j] < upperceil) ? arr[i][j] : 0) : 0; });
-	ArrayValueFilter updateMax([&](unsigned int i, unsigned int j)
-	{ maxi = std::max(maxi, arr[i][j]); });
+	// A tone of amplitude A (full scale 1) has the magnitude A / 2: 0.003 is -44 dBFS.
+	// Lower, the blobs of the residual noise merge into areas of more than 100 scale steps,
+	// which are dropped; higher, the musical tones of a noise of -35 dBFS are missed.
+	const double ceil = 0.003;
 
 	computeCWT(signal_in);
 
-	// Copy from wt, and compute maximum by the same occasion
+	// Lambdas initialisation
+	auto updateMax = [&](MaskedMatrix::value_type * const col, MaskedMatrix::size_type, MaskedMatrix::size_type j)
+	{ maxi = std::max(maxi, (double) col[j]); };
+	auto lowCeiling = [&](MaskedMatrix::value_type * const col, MaskedMatrix::size_type i, MaskedMatrix::size_type j)
+	{ if (col[j] > ceil) arr.mask(i, j); };
+
+	// Compute maximum and mask the values above the ceiling
+	arr.clearMask();
 	if (computeMax)
-		applyToArr({*copyFromWT, updateMax});
+		applyToArr(updateMax, lowCeiling);
 	else
-		applyToArr({*copyFromWT});
-
-
-	// Apply ceiling
-	//TODO Get a good ceiling estimation
-	//if (computeMax)
-	ceil = 0.03; // maxi - 10.0 / fftSize; // 0.03;
-	applyToArr({lowCeiling});
+		applyToArr(lowCeiling);
 
 
 	createFilterBinsSeparation();
@@ -174,9 +235,6 @@ void CWTNoiseEstimator::estimate(double *signal_in, double *noise_power, bool co
 #endif
 
 	computeAreasParameters();
-	reestimateNoise(noise_power);
-
-	delete wt;
 }
 
 void CWTNoiseEstimator::createFilterBinsSeparation()
@@ -194,13 +252,14 @@ void CWTNoiseEstimator::createFilterBinsSeparation()
 void CWTNoiseEstimator::computeAreasParameters()
 {
 	// Computation of mean musical tone power for each frequency bin
-	areaParams.clear();
-	for (Area  area : areas)
+	clearAreaParams();
+	const auto samples_per_column = cwt.decimation();
+	for (const Area& area : areas)
 	{
-		if (area.getWidth() >= 2 && area.getNumPixels() > 4)
+		if (area.getWidth() * samples_per_column >= 2 && area.getNumPixels() * samples_per_column > 4)
 		{
 			//          int bin = std::min(spectrumSize - 1, std::max((unsigned int) 0, getFFTBin(area.getMedianHeight())));
-			MaskedMatrix::size_type bin = std::min(spectrumSize - 1LU, std::max(0LU, getFFTBin(((long long) area.getMax()._y - (long long) 2))));
+			MaskedMatrix::size_type bin = areaBin(area);
 			areaParams[bin].numAreas += 1;
 			//          areaParams[bin].mean     += area.getSumOfValues() / area.getNumPixels();
 			areaParams[bin].mean     += area.getMax().val;
@@ -208,39 +267,26 @@ void CWTNoiseEstimator::computeAreasParameters()
 	}
 }
 
-void CWTNoiseEstimator::reestimateNoise(double *noise_power)
+void CWTNoiseEstimator::reestimateNoise(Real *noise_power)
 {
 	// Decrease of the power according to estimation
 	for (auto i = 0U; i < spectrumSize; ++i)
 	{
 		if (areaParams[i].numAreas != 0  && areaParams[i].mean > 0 && areaParams[i].mean < 1000)
 		{
-			//TODO get a good power estimation
-			//          qDebug() << "noise_power[" << i << "] =" << noise_power[i] << "  subtracted= " << areaParams[i].mean / areaParams[i].numAreas;
-			noise_power[i] = std::max(0.0, noise_power[i] -  pow(areaParams[i].mean, 2.0) / areaParams[i].numAreas);
+			// A tone of magnitude m over a whole frame has the power (fftSize * m)^2 in its bin
+			const double tone_power = pow(fftSize * areaParams[i].mean, 2.0) / areaParams[i].numAreas;
+			noise_power[i] = (Real) std::max(0.0, noise_power[i] - tone_power);
 		}
 	}
 }
 
-void CWTNoiseEstimator::applyToArr(std::initializer_list<ArrayValueFilter> funs)
-{
-	for (auto i = arr.getColPadding(); i < wt->cols(); ++i)
-		for (auto j = arr.getRowPadding(); j < wt->rows(); ++j)
-			for (auto f : funs)
-				f(i, j);
-}
-
-void CWTNoiseEstimator::writeSimpleCWT(double *signal_in)
+void CWTNoiseEstimator::writeSimpleCWT(const Real *signal_in)
 {
 	static int file_no = 0; // find a better way
 
 	computeCWT(signal_in);
-
-	// Copy from wt
-	applyToArr({*copyFromWT});
 	writeFiles("dataAfter", file_no++);
-
-	delete wt;
 }
 
 void CWTNoiseEstimator::clearAreaParams()
@@ -251,14 +297,13 @@ void CWTNoiseEstimator::clearAreaParams()
 
 double CWTNoiseEstimator::getFreq(MaskedMatrix::size_type pixel)
 {
-	return 259500.0 / double(pixel - 2); // two pixel padding
+	const double scale = double(pixel) * (AMAX - AMIN) / scales; // the row k is the scale k, padding included
+	return MorletCWT::centerFrequency() * samplingRate / scale;
 }
 
 long unsigned int CWTNoiseEstimator::getFFTBin(MaskedMatrix::size_type pixel)
 {
-	// remove static
-	static double f_per_bin = (samplingRate / 2.0) / spectrumSize;
-	return std::max(10LU, std::min((long unsigned int)(std::round(getFreq(pixel) / f_per_bin)), spectrumSize - 1LU));
+	return std::max(10LU, std::min((long unsigned int)(std::round(getFreq(pixel) / freqPerBin)), spectrumSize - 1LU));
 	// TODO 10 empirique, cf. Excel
 }
 
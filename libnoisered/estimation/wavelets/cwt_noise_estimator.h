@@ -1,20 +1,12 @@
 #pragma once
-#include <functional>
-#include <cwtlib>
-#include "area.h"
+#include <string>
+#include <utility>
+#include "area_labeller.h"
+#include "morlet_cwt.h"
+#include "../../mathutils/real.h"
 
 class SubtractionManager;
 
-using namespace cwtlib;
-/**
- * @brief Type for functions that are applied on arr.
- *
- * Basically, these functions should only do very simple operations,
- * like void f(unsigned int i, unsigned int j) { arr[i][j] += 1; }.
- * These operations should be applied only on the given coordinates.
- */
-typedef std::function<void (MaskedMatrix::size_type, MaskedMatrix::size_type)> ArrayValueFilter;
-
 #define AMIN 0                  /* A min  */
 #define ASTP 0.05               /* A step */
 #define AMAX 64                 /* A max  */
@@ -22,6 +14,16 @@ typedef std::function<void (MaskedMatrix::size_type, MaskedMatrix::size_type)> A
 /**
  * @brief This class performs the proposed musical tone reduction method using wavelet transform.
  *
+ * The scalogram (arr) is allocated once in initialize() and reused for every frame.
+ * The Morlet transform writes its magnitudes into it, and they are thresholded in a single pass.
+ * The scales go from AMIN to AMAX, in scaleCount() steps: ASTP by default.
+ *
+ * In band-limited mode, there is one scale per FFT bin instead, from the one of AMAX,
+ * and one column every decimation() samples. Only the bins given to selectBands(), and
+ * a margin around them, are transformed. An area is then mapped to the bin of its maximum,
+ * and its sizes are compared to the limits of the full scalogram in samples and scale steps.
+ *
+ * The per-frame dump of the scalogram to dataBefore/ is only compiled with PLOT_CWT.
  */
 class CWTNoiseEstimator
 {
@@ -30,10 +32,6 @@ class CWTNoiseEstimator
 		 * @brief Constructor.
 		 */
 		CWTNoiseEstimator();
-
-		CWTNoiseEstimator(const CWTNoiseEstimator&other);
-		const CWTNoiseEstimator& operator=(const CWTNoiseEstimator&);
-		~CWTNoiseEstimator();
 		/**
 		 * @brief Performs musical tones estimation.
 		 *
@@ -41,7 +39,24 @@ class CWTNoiseEstimator
 		 * @param noise_power Output noise power.
 		 * @param computeMax Set to true if the max has to be computed (on a new frame for instance)
 		 */
-		void estimate(double *signal_in, double *noise_power, bool computeMax);
+		void estimate(const Real *signal_in, Real *noise_power, bool computeMax);
+
+		/**
+		 * @brief Finds the musical tones of a frame, for the next reestimateNoise().
+		 *
+		 * @param signal_in Input signal
+		 * @param computeMax Set to true if the max has to be computed (on a new frame for instance)
+		 */
+		void detect(const Real *signal_in, bool computeMax);
+
+		/**
+		 * @brief Reestimates the noise power according to the computed musical tone parameters.
+		 *
+		 * The noise of the bin of a musical tone is lowered by the power of the tone over a frame.
+		 *
+		 * @param noise_power In-place modified noise power array.
+		 */
+		void reestimateNoise(Real *noise_power);
 
 		/**
 		 * @brief Debug function.
@@ -50,15 +65,73 @@ class CWTNoiseEstimator
 		 *
 		 * @param signal_in Input signal.
 		 */
-		void writeSimpleCWT(double *signal_in);
+		void writeSimpleCWT(const Real *signal_in);
 
 		/**
 		 * @brief Initializes some inner data.
 		 *
+		 * Does nothing if the FFT size, the sampling rate and the scale count did not change.
+		 *
 		 * @param config Configuration.
 		 */
 		void initialize(SubtractionManager &config);
 
+		/**
+		 * @brief Number of scales of the wavelet transform.
+		 *
+		 * @return unsigned int Scale count.
+		 */
+		unsigned int scaleCount() const;
+
+		/**
+		 * @brief Sets the number of scales of the wavelet transform, between AMIN and AMAX.
+		 *
+		 * Takes effect at the next initialize().
+		 *
+		 * @param value Scale count, at least 3.
+		 */
+		void setScaleCount(const unsigned int value);
+
+		/**
+		 * @brief Tells if the scalogram is band-limited and decimated.
+		 *
+		 * @return bool True in band-limited mode.
+		 */
+		bool isBandLimited() const;
+
+		/**
+		 * @brief Enables the band-limited mode.
+		 *
+		 * Takes effect at the next initialize().
+		 *
+		 * @param value True for one scale per FFT bin, on the bins selected by selectBands().
+		 */
+		void setBandLimited(const bool value);
+
+		/**
+		 * @brief Number of samples per column of the band-limited scalogram.
+		 *
+		 * @return unsigned int Decimation.
+		 */
+		unsigned int decimation() const;
+
+		/**
+		 * @brief Sets the number of samples per column of the band-limited scalogram.
+		 *
+		 * Takes effect at the next initialize(). 1 if it does not divide the FFT size.
+		 *
+		 * @param value Decimation, at least 1.
+		 */
+		void setDecimation(const unsigned int value);
+
+		/**
+		 * @brief Selects the bins transformed by the next estimations, in band-limited mode.
+		 *
+		 * They are the bins attenuated by the subtraction. Does nothing in full mode.
+		 *
+		 * @param gain Gain applied to each bin by the subtraction.
+		 */
+		void selectBands(const Real *gain);
 
 
 	private:
@@ -80,11 +153,18 @@ class CWTNoiseEstimator
 		 */
 		inline void clearAreaParams();
 
-		//**** For CWTLib ****//
-		Signal s = Signal(); /**< TODO */
-		LinearRangeFunctor scales = LinearRangeFunctor(AMIN, ASTP, AMAX); /**< TODO */
-		WTransform *wt = nullptr; /**< TODO */
+		//**** Wavelet transform ****//
+		unsigned int scales = (unsigned int) ((AMAX - AMIN) / ASTP); /**< Number of scales */
+		bool bandLimited = false; /**< One scale per bin, on the selected bands */
+		unsigned int decimationFactor = 4; /**< Samples per column in band-limited mode */
+		bool initializedBandLimited = false; /**< Mode of the last initialize() */
+		MorletCWT cwt = MorletCWT(); /**< Transform, made for the FFT size */
+		MaskedMatrix::size_type wtCols = 0; /**< Number of columns of the transform */
+		MaskedMatrix::size_type wtRows = 0; /**< Number of scales of the transform */
+		std::vector<std::pair<unsigned int, unsigned int>> bands = std::vector<std::pair<unsigned int, unsigned int>>(); /**< Rows transformed */
 		MaskedMatrix arr = MaskedMatrix(); /**< TODO */
+		double maxi = 0; /**< Maximum of the scalogram since the last reestimation of the noise */
+		AreaLabeller labeller = AreaLabeller(); /**< Finds the areas of the scalogram */
 		std::vector<Area> areas = std::vector<Area>(); /**< TODO */
 
 		/**
@@ -100,39 +180,54 @@ class CWTNoiseEstimator
 		/**
 		 * @brief Core algorithm that computes the wavelet transform.
 		 *
+		 * Writes the magnitudes, divided by the FFT size, in arr: a tone of amplitude A
+		 * in the output of the manager (full scale 1) has the magnitude A / 2.
+		 *
 		 * @param signal Input signal.
 		 */
-		void computeCWT(double *signal);
+		void computeCWT(const Real *signal);
 
 		/**
 		 * @brief Computes the areas of a WT.
 		 *
+		 * Keeps the areas of at least two samples and less than 100 scale steps.
 		 */
 		void computeAreas();
 
 		/**
-		 * @brief Apply a list of functions / lambda expressions to the array.
+		 * @brief Height of an area, in scale steps of the full scalogram.
 		 *
-		 * @param funs List of functions.
+		 * @param area Area.
+		 * @return double Height.
 		 */
-		void applyToArr(std::initializer_list<ArrayValueFilter> funs);
+		double verticalSteps(const Area& area) const;
 
 		/**
-		 * @brief Computes the parameters of the areas.
-		 *
-		 * Fills areaParams.
+		 * @brief FFT bin of the maximum of an area.
 		 *
+		 * @param area Area.
+		 * @return unsigned long Bin.
 		 */
-		void computeAreasParameters();
+		unsigned long areaBin(const Area& area);
 
 		/**
-		 * @brief Reestimates the noise power according to the computed musical tone parameters.
+		 * @brief Applies functions / lambda expressions to each pixel of the transformed bands, in a single pass.
 		 *
-		 * @param noise_power In-place modified noise power array.
+		 * Each function is called as f(arr[i], i, j) on the column i and the row j,
+		 * in the order of the arguments, and should only access these coordinates.
+		 *
+		 * @param funs Functions.
 		 */
-		void reestimateNoise(double *noise_power);
+		template<typename... Filters>
+		void applyToArr(Filters&&... funs);
 
-		ArrayValueFilter *copyFromWT = nullptr; /**< TODO */
+		/**
+		 * @brief Computes the parameters of the areas.
+		 *
+		 * Fills areaParams.
+		 *
+		 */
+		void computeAreasParameters();
 
 		/**
 		 * @brief Unused.
@@ -143,6 +238,7 @@ class CWTNoiseEstimator
 		unsigned int fftSize = 0; /**< TODO */
 		unsigned int spectrumSize = 0; /**< TODO */
 		unsigned int samplingRate = 0; /**< TODO */
+		double freqPerBin = 0; /**< Hz between two FFT bins */
 
 		/**
 		 * @brief Gets frequency from a vertical pixel in the WT.
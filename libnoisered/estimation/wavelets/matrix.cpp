@@ -1,83 +1,57 @@
+#include <algorithm>
+
 #include "matrix.h"
 
-MaskedMatrix::MaskedMatrix(const size_type cols, const size_type rows):
-	_values(cols, std::vector<double>(rows)),
-	_mask(cols, std::vector<double>(rows))
+namespace
 {
-
+	//! Values per cache line.
+	constexpr MaskedMatrix::size_type line_values = 64 / sizeof(MaskedMatrix::value_type);
 }
 
-MaskedMatrix::MaskedMatrix():
-	_values(0, std::vector<double>(0)),
-	_mask(0, std::vector<double>(0))
+MaskedMatrix::MaskedMatrix(const size_type cols, const size_type rows):
+	_cols(cols),
+	_rows(rows),
+	_stride((rows + line_values - 1) / line_values * line_values),
+	_maskStride((rows + 63) / 64),
+	_values(cols * _stride),
+	_mask(cols * _maskStride)
 {
 
 }
 
-MaskedMatrix &MaskedMatrix::operator=(const MaskedMatrix &xm)
+MaskedMatrix::MaskedMatrix()
 {
-	_values.assign(xm._values.begin(), xm._values.end());
-	_mask.assign(xm._mask.begin(), xm._mask.end());
 
-	return *this;
 }
-//Matrix &Matrix::operator=(Matrix &&xm)
-//{
-//	_mask = std::move(xm._mask);
-//	_values = std::move(xm._values);
-
-//	return *this;
-//}
 
-std::vector<double> &MaskedMatrix::operator[](MaskedMatrix::size_type n)
+MaskedMatrix::value_type *MaskedMatrix::operator[](MaskedMatrix::size_type n)
 {
-	return _values[n];
+	return _values.data() + n * _stride;
 }
 
-MaskedMatrix::size_type MaskedMatrix::size()
+const MaskedMatrix::value_type *MaskedMatrix::operator[](MaskedMatrix::size_type n) const
 {
-	return _values.size();
+	return _values.data() + n * _stride;
 }
 
-bool MaskedMatrix::is_adjacent_to_zero(const size_type i, const size_type j)
+MaskedMatrix::size_type MaskedMatrix::size() const
 {
-	return (
-			   //~ m[i+1][j+1] == 0 ||
-			   (_values[i + 1][j])   == 0 ||
-			   //~ m[i+1][j-1] == 0 ||
-			   _values[i][j + 1]   == 0 ||
-			   _values[i][j - 1]   == 0 ||
-			   //~ m[i-1][j+1] == 0 ||
-			   _values[i - 1][j]   == 0
-			   //~ m[i-1][j-1] == 0
-		   )
-		   &&
-		   (
-			   _values[i][j] != 0 &&
-			   !isMasked(i, j)
-		   )
-		   ;
+	return _cols;
 }
 
-Point<MaskedMatrix::size_type> MaskedMatrix::next_adjacent_to_zero(const size_type i, const size_type j, const size_type  x0)
+MaskedMatrix::size_type MaskedMatrix::rows() const
 {
-	if (is_adjacent_to_zero(i + 1UL, j + 1UL)) return Point<MaskedMatrix::size_type>(i + 1UL, j + 1UL);
-	if (is_adjacent_to_zero(i + 1UL, j))   return Point<MaskedMatrix::size_type>(i + 1UL, j);
-	if (is_adjacent_to_zero(i + 1UL, j - 1UL)) return Point<MaskedMatrix::size_type>(i + 1UL, j - 1UL);
-	if (is_adjacent_to_zero(i, j + 1UL))   return Point<MaskedMatrix::size_type>(i,   j + 1UL);
-	if (is_adjacent_to_zero(i, j - 1UL))   return Point<MaskedMatrix::size_type>(i,   j - 1UL);
-	if (is_adjacent_to_zero(i - 1UL, j + 1UL) && i > x0) return Point<MaskedMatrix::size_type>(i - 1UL, j + 1UL);
-	if (is_adjacent_to_zero(i - 1UL, j)   && i > x0) return Point<MaskedMatrix::size_type>(i - 1UL, j);
-	if (is_adjacent_to_zero(i - 1UL, j - 1UL) && i > x0) return Point<MaskedMatrix::size_type>(i - 1UL, j - 1UL);
+	return _rows;
+}
 
-	// Let's hope it does not happen!
-	// std::cout << "bad things happens next_adjacent_to_zero\n";
-	return (Point<MaskedMatrix::size_type>(0, 0, true));
+MaskedMatrix::size_type MaskedMatrix::stride() const
+{
+	return _stride;
 }
 
-const std::vector<std::vector<double>> &MaskedMatrix::getMask() const
+const std::uint64_t *MaskedMatrix::maskColumn(MaskedMatrix::size_type n) const
 {
-	return _mask;
+	return _mask.data() + n * _maskStride;
 }
 
 MaskedMatrix::size_type MaskedMatrix::getColPadding() const
@@ -100,17 +74,22 @@ void MaskedMatrix::setRowPadding(const size_type &value)
 	_rowPadding = value;
 }
 
-bool MaskedMatrix::isMasked(const size_type i, const size_type j)
+bool MaskedMatrix::isMasked(const size_type i, const size_type j) const
 {
-	return _mask[i][j] == mask_value;
+	return (_mask[i * _maskStride + j / 64] >> (j % 64)) & 1;
 }
 
 void MaskedMatrix::mask(const size_type i, const size_type j)
 {
-	_mask[i][j] = mask_value;
+	_mask[i * _maskStride + j / 64] |= std::uint64_t(1) << (j % 64);
 }
 
 void MaskedMatrix::unmask(const size_type i, const size_type j)
 {
-	_mask[i][j] = 0;
+	_mask[i * _maskStride + j / 64] &= ~(std::uint64_t(1) << (j % 64));
+}
+
+void MaskedMatrix::clearMask()
+{
+	std::fill(_mask.begin(), _mask.end(), 0);
 }
@@ -1,67 +1,78 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include "point.h"
 
 /**
- * @brief Represents a double-valued matrix.
+ * @brief Represents a float-valued matrix, with a mask of one bit per value.
  *
  * Access is in column - row fashion, because this is more efficient for the algorithm used and for cache locality.
+ * The values are stored in a single buffer, column after column: each column starts
+ * stride() values after the previous one, which is the number of rows rounded up to a cache line.
+ * The mask is stored the same way, 64 rows per word.
  *
  */
 class MaskedMatrix
 {
 	public:
-		typedef std::vector<std::vector<double>>::size_type size_type;
+		typedef std::vector<float>::size_type size_type;
+		typedef float value_type;
+
 		/**
 		 * @brief Constructor
 		 *
+		 * The values are 0 and the mask is clear.
+		 *
 		 * @param cols Number of columns.
 		 * @param rows Number of rows.
 		 */
 		MaskedMatrix(const size_type cols, const size_type rows);
 		MaskedMatrix();
 
-		MaskedMatrix& operator=(const MaskedMatrix&);
-		//Matrix& operator=(Matrix&&);
-		std::vector<double>& operator[](size_type n);
-		size_type size();
 		/**
-		 * @brief Returns true if a point is adjacent to zero.
-		 *
-		 * Doesn't check diagonals.
+		 * @brief Column n.
 		 *
-		 * @param i Column.
-		 * @param j Line.
-		 * @return bool True if matrix[i][j] is adjacent to 0.
+		 * @param n Column.
+		 * @return value_type* rows() values.
 		 */
-		bool is_adjacent_to_zero(const size_type i, const size_type j);
+		value_type *operator[](size_type n);
+		const value_type *operator[](size_type n) const;
 
 		/**
-		 * @brief Returns one of the nearest unexplored point which is adjacent to zero.
-		 *
-		 * The point must have a value > 0.
-		 * If there is no satisfying point, one with the invalid status set to true will be returned.
+		 * @brief Number of columns.
 		 *
-		 * @param i Column.
-		 * @param j Line.
-		 * @param x0 Left limit.
+		 * @return size_type Columns.
+		 */
+		size_type size() const;
+
+		/**
+		 * @brief Number of rows.
 		 *
-		 * @return Point A Point which satisfies the conditions.
+		 * @return size_type Rows.
 		 */
-		Point<size_type> next_adjacent_to_zero(const size_type i, const size_type j, const size_type x0);
+		size_type rows() const;
 
 		/**
-		 * @brief Returns the mask of the matrix.
+		 * @brief Distance between two columns in the buffer.
 		 *
-		 * @return const std::vector<std::vector<double>> Corresponding mask.
+		 * @return size_type Number of values, at least rows().
 		 */
-		const std::vector<std::vector<double>> &getMask() const;
+		size_type stride() const;
 
+		/**
+		 * @brief Mask of a column.
+		 *
+		 * The row j is the bit j % 64 of the word j / 64. The bits after rows() are clear.
+		 *
+		 * @param n Column.
+		 * @return const std::uint64_t* (rows() + 63) / 64 words.
+		 */
+		const std::uint64_t *maskColumn(size_type n) const;
 
 		/**
 		 * @brief Returns the column at which the data starts.
 		 *
-		 * There is a padding around the data (usually 2 pixels) to allow the algorithm to work.
+		 * The padding columns and rows are part of the matrix, but not used by the algorithm (usually 2 pixels).
 		 *
 		 * @return unsigned int Column.
 		 */
@@ -77,7 +88,7 @@ class MaskedMatrix
 		/**
 		 * @brief Returns the row at which the data starts.
 		 *
-		 * There is a padding around the data (usually 2 pixels) to allow the algorithm to work.
+		 * The padding columns and rows are part of the matrix, but not used by the algorithm (usually 2 pixels).
 		 *
 		 * @return unsigned int Row.
 		 */
@@ -90,8 +101,6 @@ class MaskedMatrix
 		 */
 		void setRowPadding(const size_type  &value);
 
-		const unsigned int mask_value = 2; /**< TODO */
-
 		/**
 		 * @brief Returns true if the value at (i, j) is masked.
 		 *
@@ -101,7 +110,7 @@ class MaskedMatrix
 		 * @param j Row.
 		 * @return bool True if matrix[i][j] is masked.
 		 */
-		bool isMasked(const size_type i, const size_type j);
+		bool isMasked(const size_type i, const size_type j) const;
 
 		/**
 		 * @brief Masks the value at (i, j).
@@ -119,11 +128,20 @@ class MaskedMatrix
 		 */
 		void unmask(const size_type i, const size_type j);
 
+		/**
+		 * @brief Unmasks all the values.
+		 */
+		void clearMask();
+
 	private:
 		size_type _colPadding = 0; /**< TODO */
 		size_type _rowPadding = 0; /**< TODO */
 
-		std::vector<std::vector<double>> _values; /**< TODO */
-		std::vector<std::vector<double>> _mask; /**< TODO */
+		size_type _cols = 0; /**< Number of columns */
+		size_type _rows = 0; /**< Number of rows */
+		size_type _stride = 0; /**< Values between two columns */
+		size_type _maskStride = 0; /**< Mask words per column */
+		std::vector<value_type> _values = std::vector<value_type>(); /**< Columns, _stride values each */
+		std::vector<std::uint64_t> _mask = std::vector<std::uint64_t>(); /**< Columns, _maskStride words each */
 
 };
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+#include "morlet_cwt.h"
+
+namespace
+{
+	//! Number of scales transformed by one FFTW call.
+	constexpr unsigned int scales_per_block = 16;
+
+	//! Half width of the kernels, in standard deviations of the Gaussian (exp(-18) ~ 1.5e-8).
+	constexpr double kernel_half_width = 6.0;
+
+	/**
+	 * @brief Returns the plan of the in-place backward FFTs of a block of scales, made on first use.
+	 *
+	 * Like the plans of FFTWManager, it is shared by all the transforms of the process and never
+	 * destroyed. It is run on the block of each transform with execute_dft: fftw_alloc gives the
+	 * alignment of the planning buffer.
+	 *
+	 * @param columns Size of the FFTs.
+	 */
+	FFTW(plan) sharedPlan(const unsigned int columns)
+	{
+		static std::map<std::pair<unsigned int, FFTWManager::PlannerEffort>, FFTW(plan)> registry;
+
+		std::lock_guard<std::mutex> lock(FFTWManager::plannerMutex());
+		const auto key = std::make_pair(columns, FFTWManager::plannerEffort());
+		auto it = registry.find(key);
+		if (it == registry.end())
+		{
+			// Measuring overwrites the buffer: it is only used for planning.
+			const int n = (int) columns;
+			FFTW(complex) * const block = FFTW(alloc_complex)(columns * scales_per_block);
+			const FFTW(plan) plan = FFTW(plan_many_dft)(1, &n, (int) scales_per_block,
+														block, nullptr, 1, n,
+														block, nullptr, 1, n,
+														FFTW_BACKWARD, FFTWManager::plannerFlags());
+			FFTW(free)(block);
+
+			it = registry.insert(std::make_pair(key, plan)).first;
+		}
+		return it->second;
+	}
+}
+
+MorletCWT::MorletCWT()
+{
+}
+
+MorletCWT::MorletCWT(const MorletCWT &other):
+	_size(other._size),
+	_decimation(other._decimation),
+	_firstScale(other._firstScale),
+	_scaleCount(other._scaleCount),
+	_gain(other._gain),
+	_kernels(other._kernels),
+	_fft(other._fft)
+{
+	makePlan();
+}
+
+MorletCWT &MorletCWT::operator=(const MorletCWT &other)
+{
+	_size = other._size;
+	_decimation = other._decimation;
+	_firstScale = other._firstScale;
+	_scaleCount = other._scaleCount;
+	_gain = other._gain;
+	_kernels = other._kernels;
+	_fft = other._fft;
+	makePlan();
+
+	return *this;
+}
+
+MorletCWT::~MorletCWT()
+{
+	destroy();
+}
+
+double MorletCWT::centerFrequency()
+{
+	return 0.8109375;
+}
+
+void MorletCWT::initialize(const unsigned int size, const unsigned int first_scale, const unsigned int scale_count,
+						   const double scale_step, const double gain)
+{
+	_size = size;
+	_decimation = 1;
+	_firstScale = std::min(first_scale, scale_count);
+	_scaleCount = scale_count;
+	_gain = gain;
+	_fft.updateSize(size);
+
+	computeKernels([scale_step](const unsigned int k) { return k * scale_step; });
+	makePlan();
+}
+
+void MorletCWT::initializeBins(const unsigned int size, const unsigned int first_bin, const double gain,
+							   const unsigned int decimation)
+{
+	_size = size;
+	_decimation = (decimation > 0 && size % decimation == 0) ? decimation : 1;
+	_scaleCount = size / 2 + 1;
+	_firstScale = std::min(std::max(first_bin, 1U), _scaleCount);
+	_gain = gain;
+	_fft.updateSize(size);
+
+	const double scale_of_bin = centerFrequency() * size;
+	computeKernels([scale_of_bin](const unsigned int k) { return scale_of_bin / k; });
+	makePlan();
+}
+
+template<typename ScaleFunction>
+void MorletCWT::computeKernels(ScaleFunction scale)
+{
+	// psi(a w) on the positive bins, with the 1 / size of the inverse FFT and the gain
+	const double w0 = 2 * M_PI * centerFrequency();
+	const double bin_width = 2 * M_PI / _size;
+	const double norm = _gain / _size;
+
+	std::shared_ptr<Kernels> kernels = std::make_shared<Kernels>();
+	for (auto k = _firstScale; k < _scaleCount; ++k)
+	{
+		const double a = scale(k);
+		const double w_low = std::max(0.0, (w0 - kernel_half_width) / a);
+		const double w_high = std::min(M_PI, (w0 + kernel_half_width) / a);
+		const unsigned int first = (unsigned int) std::ceil(w_low / bin_width);
+		const unsigned int last = std::max(first, (unsigned int) std::floor(w_high / bin_width) + 1);
+
+		kernels->offset.push_back((unsigned int) kernels->values.size());
+		kernels->first.push_back(first);
+		kernels->length.push_back(last - first);
+		for (auto b = first; b < last; ++b)
+		{
+			const double x = a * b * bin_width - w0;
+			kernels->values.push_back(b == 0 ? 0 : (Real) (norm * std::exp(-x * x / 2)));
+		}
+	}
+	_kernels = kernels;
+}
+
+void MorletCWT::transform(const Real *signal, MaskedMatrix &arr, const unsigned int first_column)
+{
+	std::copy_n(signal, _size, _fft.input());
+	_fft.forward();
+	transformScales(arr, first_column, _firstScale, _scaleCount);
+}
+
+void MorletCWT::transform(const Real *signal, MaskedMatrix &arr, const unsigned int first_column,
+						  const std::vector<std::pair<unsigned int, unsigned int>> &scales)
+{
+	std::copy_n(signal, _size, _fft.input());
+	_fft.forward();
+	for (const auto& range : scales)
+		transformScales(arr, first_column, std::max(range.first, _firstScale), std::min(range.second, _scaleCount));
+}
+
+void MorletCWT::transformScales(MaskedMatrix &arr, const unsigned int first_column,
+								const unsigned int k_begin, const unsigned int k_end)
+{
+	const std::complex<Real> * const spectrum = _fft.spectrum();
+	const Kernels& kernels = *_kernels;
+	const unsigned int columns = _size / _decimation;
+
+	for (auto k0 = k_begin; k0 < k_end; k0 += scales_per_block)
+	{
+		const unsigned int count = std::min(scales_per_block, k_end - k0);
+
+		// Spectrum times kernel, 0 on the negative frequencies, folded modulo the columns
+		for (auto s = 0U; s < count; ++s)
+		{
+			const unsigned int kernel = k0 - _firstScale + s;
+			const unsigned int length = kernels.length[kernel];
+			const Real * const values = kernels.values.data() + kernels.offset[kernel];
+			const std::complex<Real> * const bins = spectrum + kernels.first[kernel];
+			std::complex<Real> * const row = _block + s * columns;
+
+			std::fill_n(row, columns, 0);
+			for (auto b = 0U, c = kernels.first[kernel] % columns; b < length; ++b)
+			{
+				row[c] += bins[b] * values[b];
+				if (++c == columns) c = 0;
+			}
+		}
+
+		// The rows after count, on the last block, are transformed but not read
+		FFTW(complex) * const block = reinterpret_cast<FFTW(complex)*>(_block);
+		FFTW(execute_dft)(_plan, block, block);
+
+		for (auto m = first_column; m < columns; ++m)
+		{
+			auto col = arr[m] + k0;
+			for (auto s = 0U; s < count; ++s)
+			{
+				const std::complex<Real> c = _block[s * columns + m];
+				col[s] = (MaskedMatrix::value_type) std::sqrt(c.real() * c.real() + c.imag() * c.imag());
+			}
+		}
+	}
+}
+
+unsigned int MorletCWT::size() const
+{
+	return _size;
+}
+
+unsigned int MorletCWT::scaleCount() const
+{
+	return _scaleCount;
+}
+
+unsigned int MorletCWT::decimation() const
+{
+	return _decimation;
+}
+
+void MorletCWT::makePlan()
+{
+	destroy();
+	if (_size == 0) return;
+
+	// Only the block belongs to the instance: copies do not plan again
+	const unsigned int columns = _size / _decimation;
+	_block = reinterpret_cast<std::complex<Real>*>(FFTW(alloc_complex)(columns * scales_per_block));
+	std::fill_n(_block, columns * scales_per_block, 0);
+	_plan = sharedPlan(columns);
+}
+
+void MorletCWT::destroy()
+{
+	if (_block) FFTW(free)(_block);
+	_plan = nullptr;
+	_block = nullptr;
+}
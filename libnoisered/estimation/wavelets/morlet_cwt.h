@@ -0,0 +1,164 @@
+#pragma once
+#include <complex>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <fftw3.h>
+
+#include "matrix.h"
+#include "../../fft/fftwmanager.h"
+#include "../../mathutils/real.h"
+
+/**
+ * @brief Complex Morlet continuous wavelet transform, computed by FFT.
+ *
+ * The wavelet of scale a is, in the frequency domain,
+ * psi(a w) = exp(-(a w - w0)^2 / 2) for w > 0, and 0 for w <= 0.
+ * The scale k is a = k * scale step. The centre frequency of the scale a is
+ * centerFrequency() / a cycles per sample, e.g. 12975 / a Hz at 16 kHz.
+ *
+ * The kernels have a peak of 1 at every scale (amplitude normalization, not the energy
+ * normalization sqrt(2 pi a) pi^(-1/4) of Torrence & Compo): a sine of amplitude A has the
+ * magnitude gain * A / 2 at the scale of its frequency, whatever the scale.
+ *
+ * The kernels of the scales are computed once per initialize(), on the bins where
+ * the Gaussian is above 1e-8 of its peak, and shared by the copies of the transform.
+ * For each frame, the spectrum of the signal is multiplied by the kernels, and the
+ * inverse FFTs of blocks of scales are computed by one batched FFTW call. Only the
+ * magnitudes are kept. The plan of that call is made once per size and planner effort
+ * for the whole process: only the block buffer belongs to each transform.
+ *
+ * With a decimation D, only the samples t = m D are computed: the products are folded
+ * modulo size() / D before an inverse FFT of size() / D, which gives exactly the same
+ * magnitudes at these samples, D times cheaper.
+ */
+class MorletCWT
+{
+	public:
+		MorletCWT();
+		MorletCWT(const MorletCWT& other);
+		MorletCWT& operator=(const MorletCWT& other);
+		~MorletCWT();
+
+		/**
+		 * @brief Computes the kernels and makes the plans.
+		 *
+		 * @param size Number of samples of the signal.
+		 * @param first_scale First scale computed.
+		 * @param scale_count Number of scales: the scales first_scale to scale_count - 1 are computed.
+		 * @param scale_step Step between two scales.
+		 * @param gain Factor applied to the magnitudes.
+		 */
+		void initialize(const unsigned int size, const unsigned int first_scale, const unsigned int scale_count,
+						const double scale_step, const double gain);
+
+		/**
+		 * @brief Computes the kernels and makes the plans, with one scale per FFT bin.
+		 *
+		 * The scale k is the one whose centre frequency is the bin k: a = centerFrequency() * size / k.
+		 * There are size / 2 + 1 scales.
+		 *
+		 * @param size Number of samples of the signal.
+		 * @param first_bin First scale computed, at least 1.
+		 * @param gain Factor applied to the magnitudes.
+		 * @param decimation Samples per column of the output. 1 if it does not divide size.
+		 */
+		void initializeBins(const unsigned int size, const unsigned int first_bin, const double gain,
+							const unsigned int decimation);
+
+		/**
+		 * @brief Magnitudes of the transform of a signal.
+		 *
+		 * The magnitude of the scale k at the sample t = m * decimation() is written in arr[m][k],
+		 * for m >= first_column and the scales given to initialize().
+		 *
+		 * @param signal size() samples.
+		 * @param arr Output, with at least size() / decimation() columns and scaleCount() rows.
+		 * @param first_column First column written.
+		 */
+		void transform(const Real *signal, MaskedMatrix& arr, const unsigned int first_column);
+
+		/**
+		 * @brief Magnitudes of the transform of a signal, on some ranges of scales only.
+		 *
+		 * Same as above, for the scales first <= k < second of each range.
+		 *
+		 * @param signal size() samples.
+		 * @param arr Output, with at least size() / decimation() columns and scaleCount() rows.
+		 * @param first_column First column written.
+		 * @param scales Ranges of scales, clamped to the ones given to initialize().
+		 */
+		void transform(const Real *signal, MaskedMatrix& arr, const unsigned int first_column,
+					   const std::vector<std::pair<unsigned int, unsigned int>>& scales);
+
+		/**
+		 * @brief Number of samples of the signal.
+		 *
+		 * @return unsigned int Size.
+		 */
+		unsigned int size() const;
+
+		/**
+		 * @brief Number of scales, including the ones before the first scale computed.
+		 *
+		 * @return unsigned int Scale count.
+		 */
+		unsigned int scaleCount() const;
+
+		/**
+		 * @brief Number of samples per column of the output.
+		 *
+		 * @return unsigned int Decimation.
+		 */
+		unsigned int decimation() const;
+
+		/**
+		 * @brief Centre frequency of the scale 1.
+		 *
+		 * @return double Frequency, in cycles per sample.
+		 */
+		static double centerFrequency();
+
+	private:
+		/**
+		 * @brief Non-zero part of the kernels of all the scales.
+		 *
+		 * The kernel of the scale first_scale + s is values[offset[s] + b - first[s]]
+		 * on the bins first[s] <= b < first[s] + length[s], 0 elsewhere.
+		 */
+		struct Kernels
+		{
+			std::vector<Real> values = std::vector<Real>();
+			std::vector<unsigned int> offset = std::vector<unsigned int>();
+			std::vector<unsigned int> first = std::vector<unsigned int>();
+			std::vector<unsigned int> length = std::vector<unsigned int>();
+		};
+
+		/**
+		 * @brief Computes the kernels of the scales _firstScale to _scaleCount - 1.
+		 *
+		 * @param scale Scale of a row.
+		 */
+		template<typename ScaleFunction>
+		void computeKernels(ScaleFunction scale);
+
+		/**
+		 * @brief Transforms the scales k_begin to k_end - 1 of the spectrum in _fft.
+		 */
+		void transformScales(MaskedMatrix& arr, const unsigned int first_column,
+							 const unsigned int k_begin, const unsigned int k_end);
+
+		void makePlan();
+		void destroy();
+
+		unsigned int _size = 0;
+		unsigned int _decimation = 1;
+		unsigned int _firstScale = 0;
+		unsigned int _scaleCount = 0;
+		double _gain = 1;
+
+		std::shared_ptr<const Kernels> _kernels = std::shared_ptr<const Kernels>();
+		FFTWManager _fft = FFTWManager(); /**< Spectrum of the signal */
+		std::complex<Real> *_block = nullptr; /**< Transforms of a block of scales, one row of size() / _decimation per scale */
+		FFTW(plan) _plan = nullptr; /**< In-place backward FFTs of a block, shared by the process, run on _block */
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include "mathutils/real.h"
 
 //! Useful evaluation functions, like NRR and SDR.
 namespace Eval
@@ -14,7 +15,7 @@ namespace Eval
 	*
 	* @return double NRR.
 	*/
-	double NRR(const double * original, const double * reduced, const unsigned int length);
+	double NRR(const Real * original, const Real * reduced, const unsigned int length);
 
 	// Computes speech distortion quantity
 	/**
@@ -28,5 +29,5 @@ namespace Eval
 	*
 	* @return double SDR.
 	*/
-	double SDR(const double * original, const double * reduced, const unsigned int length);
+	double SDR(const Real * original, const Real * reduced, const unsigned int length);
 }
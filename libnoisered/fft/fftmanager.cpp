@@ -8,9 +8,9 @@ FFTManager::FFTManager()
 FFTManager::FFTManager(const FFTManager &fm)
 {
 	_fftSize = fm.size();
-	_in = new double[size()];
-	_out = new double[size()];
-	_spectrum = new std::complex<double>[spectrumSize()];
+	_in = new Real[size()];
+	_out = new Real[size()];
+	_spectrum = new std::complex<Real>[spectrumSize()];
 
 	std::copy_n(fm.input(), size(), _in);
 	std::copy_n(fm.output(), size(), _out);
@@ -25,9 +25,9 @@ const FFTManager &FFTManager::operator=(const FFTManager &fm)
 		delete[] _in;
 		delete[] _out;
 		delete[] _spectrum;
-		_in = new double[size()];
-		_out = new double[size()];
-		_spectrum = new std::complex<double>[spectrumSize()];
+		_in = new Real[size()];
+		_out = new Real[size()];
+		_spectrum = new std::complex<Real>[spectrumSize()];
 	}
 
 	std::copy_n(fm.input(), size(), _in);
@@ -45,17 +45,17 @@ FFTManager::~FFTManager()
 }
 
 
-double *FFTManager::input() const
+Real *FFTManager::input() const
 {
 	return _in;
 }
 
-double *FFTManager::output() const
+Real *FFTManager::output() const
 {
 	return _out;
 }
 
-std::complex<double> *FFTManager::spectrum() const
+std::complex<Real> *FFTManager::spectrum() const
 {
 	return _spectrum;
 }
@@ -73,7 +73,7 @@ unsigned int FFTManager::size() const
 void FFTManager::updateSize(const unsigned int n)
 {
 	_fftSize = n;
-	_in = new double[size()];
-	_out = new double[size()];
-	_spectrum = new std::complex<double>[spectrumSize()];
+	_in = new Real[size()];
+	_out = new Real[size()];
+	_spectrum = new std::complex<Real>[spectrumSize()];
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <complex>
+#include "../mathutils/real.h"
 
 /**
  * @brief Interface to follow for implementation of FFT algorithms.
@@ -18,13 +19,13 @@ class FFTManager
 		 * @brief input
 		 * @return a pointer to the input data.
 		 */
-		double* input() const;
+		Real* input() const;
 
 		/**
 		 * @brief output
 		 * @return a pointer to the output data.
 		 */
-		double* output() const;
+		Real* output() const;
 
 		/**
 		 * @brief Forward FFT.
@@ -44,7 +45,7 @@ class FFTManager
 		 * @brief Spectrum
 		 * @return The spectrum
 		 */
-		std::complex<double>* spectrum() const;
+		std::complex<Real>* spectrum() const;
 
 		/**
 		 * @brief Spectrum size
@@ -58,7 +59,7 @@ class FFTManager
 		 * Sometimes, the fft implementation might give an output which needs to be normalized.
 		 * @return The factor by which every sample of the ouput must be multiplied.
 		 */
-		virtual double normalizationFactor() const = 0;
+		virtual Real normalizationFactor() const = 0;
 
 		/**
 		 * @brief size
@@ -69,9 +70,9 @@ class FFTManager
 		virtual void updateSize(const unsigned int);
 
 	protected:
-		std::complex<double>* _spectrum = nullptr;
-		double *_in = nullptr;
-		double *_out = nullptr;
+		std::complex<Real>* _spectrum = nullptr;
+		Real *_in = nullptr;
+		Real *_out = nullptr;
 		unsigned int _fftSize = 0;
 
 };
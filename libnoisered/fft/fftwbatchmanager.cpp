@@ -0,0 +1,103 @@
+#include <algorithm>
+
+#include "fftwbatchmanager.h"
+#include "fftwmanager.h"
+
+FFTWBatchManager::FFTWBatchManager()
+{
+}
+
+FFTWBatchManager::~FFTWBatchManager()
+{
+	destroy();
+}
+
+void FFTWBatchManager::forward() const
+{
+	FFTW(execute)(_fw);
+}
+
+void FFTWBatchManager::backward() const
+{
+	FFTW(execute)(_bw);
+}
+
+void FFTWBatchManager::updateSize(const unsigned int size, const unsigned int count)
+{
+	destroy();
+	_size = size;
+	_count = count;
+
+	_in = FFTW(alloc_real)(_size * _count);
+	_out = FFTW(alloc_real)(_size * _count);
+	_spectrum = reinterpret_cast<std::complex<Real>*>(FFTW(alloc_complex)(spectrumSize() * _count));
+
+	// One contiguous array per transform. Measuring overwrites the buffers, they are cleared afterwards.
+	const int n = (int) _size;
+	FFTW(complex) * const spectrum = reinterpret_cast<FFTW(complex)*>(_spectrum);
+	std::unique_lock<std::mutex> lock(FFTWManager::plannerMutex());
+	_fw = FFTW(plan_many_dft_r2c)(1, &n, (int) _count,
+								  _in, nullptr, 1, n,
+								  spectrum, nullptr, 1, (int) spectrumSize(),
+								  FFTWManager::plannerFlags());
+	_bw = FFTW(plan_many_dft_c2r)(1, &n, (int) _count,
+								  spectrum, nullptr, 1, (int) spectrumSize(),
+								  _out, nullptr, 1, n,
+								  FFTWManager::plannerFlags());
+	lock.unlock();
+	std::fill_n(_in, _size * _count, 0);
+	std::fill_n(_out, _size * _count, 0);
+	std::fill_n(_spectrum, spectrumSize() * _count, 0);
+}
+
+Real *FFTWBatchManager::input(const unsigned int i) const
+{
+	return _in + i * _size;
+}
+
+Real *FFTWBatchManager::output(const unsigned int i) const
+{
+	return _out + i * _size;
+}
+
+std::complex<Real> *FFTWBatchManager::spectrum(const unsigned int i) const
+{
+	return _spectrum + i * spectrumSize();
+}
+
+unsigned int FFTWBatchManager::size() const
+{
+	return _size;
+}
+
+unsigned int FFTWBatchManager::spectrumSize() const
+{
+	return _size / 2 + 1;
+}
+
+unsigned int FFTWBatchManager::count() const
+{
+	return _count;
+}
+
+Real FFTWBatchManager::normalizationFactor() const
+{
+	return Real(1) / (Real) _size;
+}
+
+void FFTWBatchManager::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(FFTWManager::plannerMutex());
+		if (_fw) FFTW(destroy_plan)(_fw);
+		if (_bw) FFTW(destroy_plan)(_bw);
+	}
+	if (_in) FFTW(free)(_in);
+	if (_out) FFTW(free)(_out);
+	if (_spectrum) FFTW(free)(_spectrum);
+	_fw = nullptr;
+	_bw = nullptr;
+	_in = nullptr;
+	_out = nullptr;
+	_spectrum = nullptr;
+}
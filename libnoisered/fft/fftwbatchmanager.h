@@ -0,0 +1,96 @@
+#pragma once
+
+#include <complex>
+#include <fftw3.h>
+#include "../mathutils/real.h"
+
+/**
+ * @brief Several FFTs of the same size, computed by a single FFTW call.
+ *
+ * The inputs, outputs and spectra are planar: the arrays of the transforms
+ * follow each other in a single buffer. The plans are made with
+ * plan_many_dft_r2c / c2r and the planner effort of FFTWManager, under its planner lock.
+ */
+class FFTWBatchManager
+{
+	public:
+		FFTWBatchManager();
+		~FFTWBatchManager();
+
+		FFTWBatchManager(const FFTWBatchManager&) = delete;
+		FFTWBatchManager& operator=(const FFTWBatchManager&) = delete;
+
+		/**
+		 * @brief Forward FFT of every input.
+		 */
+		void forward() const;
+
+		/**
+		 * @brief Backward FFT of every spectrum. The spectra are overwritten.
+		 */
+		void backward() const;
+
+		/**
+		 * @brief Makes the plans and buffers.
+		 *
+		 * @param size FFT size.
+		 * @param count Number of transforms.
+		 */
+		void updateSize(const unsigned int size, const unsigned int count);
+
+		/**
+		 * @brief input
+		 * @param i Transform.
+		 * @return Input of transform i, FFT size.
+		 */
+		Real *input(const unsigned int i) const;
+
+		/**
+		 * @brief output
+		 * @param i Transform.
+		 * @return Output of transform i, FFT size.
+		 */
+		Real *output(const unsigned int i) const;
+
+		/**
+		 * @brief spectrum
+		 * @param i Transform.
+		 * @return Spectrum of transform i, spectrum size.
+		 */
+		std::complex<Real> *spectrum(const unsigned int i) const;
+
+		/**
+		 * @brief size
+		 * @return FFT size.
+		 */
+		unsigned int size() const;
+
+		/**
+		 * @brief Spectrum size
+		 * @return FFT size / 2 + 1.
+		 */
+		unsigned int spectrumSize() const;
+
+		/**
+		 * @brief count
+		 * @return Number of transforms.
+		 */
+		unsigned int count() const;
+
+		/**
+		 * @brief Normalization factor
+		 * @return The factor by which every sample of the output must be multiplied.
+		 */
+		Real normalizationFactor() const;
+
+	private:
+		void destroy();
+
+		Real *_in = nullptr;
+		Real *_out = nullptr;
+		std::complex<Real> *_spectrum = nullptr;
+		FFTW(plan) _fw = nullptr;
+		FFTW(plan) _bw = nullptr;
+		unsigned int _size = 0;
+		unsigned int _count = 0;
+};
@@ -1,12 +1,25 @@
+#include <algorithm>
+
 #include "fftwmanager.h"
 
 
-unsigned int FFTWManager::_num_instances = 0;
+std::atomic<FFTWManager::PlannerEffort> FFTWManager::_effort(FFTWManager::PlannerEffort::Estimate);
+
+static unsigned int flagsOf(const FFTWManager::PlannerEffort effort)
+{
+	static const std::map<FFTWManager::PlannerEffort, unsigned int> flags
+	{
+		std::make_pair(FFTWManager::PlannerEffort::Estimate, FFTW_ESTIMATE),
+		std::make_pair(FFTWManager::PlannerEffort::Measure, FFTW_MEASURE),
+		std::make_pair(FFTWManager::PlannerEffort::Patient, FFTW_PATIENT)
+	};
+
+	return flags.at(effort);
+}
 
 FFTWManager::FFTWManager():
 	FFTManager()
 {
-	_num_instances++;
 }
 
 FFTWManager::FFTWManager(const FFTWManager &fm):
@@ -23,20 +36,13 @@ const FFTWManager &FFTWManager::operator=(const FFTWManager &fm)
 
 FFTWManager::~FFTWManager()
 {
-	if(_in) fftw_free(_in);
-	if(_out) fftw_free(_out);
-	if(_spectrum) fftw_free(_spectrum);
+	for(auto& p : _plans)
+		destroy(p.second);
 
+	// The buffers belong to the cache
 	_in = nullptr;
 	_out = nullptr;
 	_spectrum = nullptr;
-
-	if(plan_fw) fftw_destroy_plan(plan_fw);
-	if(plan_bw) fftw_destroy_plan(plan_bw);
-
-	_num_instances--;
-	if(_num_instances == 0)
-		fftw_cleanup();
 }
 
 FFTManager *FFTWManager::clone()
@@ -46,36 +52,117 @@ FFTManager *FFTWManager::clone()
 
 void FFTWManager::forward() const
 {
-	fftw_execute(plan_fw);
+	FFTW(execute_dft_r2c)(plan_fw, _in, reinterpret_cast<FFTW(complex)*>(_spectrum));
 }
 
 void FFTWManager::backward() const
 {
-	fftw_execute(plan_bw);
+	FFTW(execute_dft_c2r)(plan_bw, reinterpret_cast<FFTW(complex)*>(_spectrum), _out);
 }
 
-double FFTWManager::normalizationFactor() const
+Real FFTWManager::normalizationFactor() const
 {
-	return 1.0 / size();
+	return Real(1) / (Real) size();
 }
 
 void FFTWManager::updateSize(const unsigned int n)
 {
 	_fftSize = n;
+	const PlannerEffort effort = _effort;
+
+	auto it = _plans.find(n);
+	if(it == _plans.end())
+	{
+		Plan p;
+		p.in = FFTW(alloc_real)(_fftSize);
+		p.out = FFTW(alloc_real)(_fftSize);
+		p.spectrum = reinterpret_cast<std::complex<Real>*>(FFTW(alloc_complex)(spectrumSize()));
+		std::fill_n(p.in, _fftSize, 0);
+		std::fill_n(p.out, _fftSize, 0);
+		std::fill_n(p.spectrum, spectrumSize(), 0);
+		sharedPlans(_fftSize, effort, p.fw, p.bw);
+		p.effort = effort;
+
+		it = _plans.insert(std::make_pair(n, p)).first;
+	}
+	else if(it->second.effort != effort)
+	{
+		sharedPlans(_fftSize, effort, it->second.fw, it->second.bw);
+		it->second.effort = effort;
+	}
+
+	_in = it->second.in;
+	_out = it->second.out;
+	_spectrum = it->second.spectrum;
+	plan_fw = it->second.fw;
+	plan_bw = it->second.bw;
+}
 
-	if(_in) fftw_free(_in);
-	if(_out) fftw_free(_out);
-	if(_spectrum) fftw_free(_spectrum);
+void FFTWManager::sharedPlans(const unsigned int size, const PlannerEffort effort, FFTW(plan) &fw, FFTW(plan) &bw)
+{
+	// Never destroyed: instances on other threads may be executing them.
+	// FFTW plans are only valid on buffers with the alignment of the planning ones: fftw_alloc gives the same.
+	static std::map<std::pair<unsigned int, PlannerEffort>, std::pair<FFTW(plan), FFTW(plan)>> registry;
+
+	std::lock_guard<std::mutex> lock(plannerMutex());
+	auto it = registry.find(std::make_pair(size, effort));
+	if(it == registry.end())
+	{
+		// Measuring overwrites the buffers: they are only used for planning.
+		const unsigned int spectrum_size = size / 2 + 1;
+		Real * const in = FFTW(alloc_real)(size);
+		Real * const out = FFTW(alloc_real)(size);
+		FFTW(complex) * const spectrum = FFTW(alloc_complex)(spectrum_size);
+
+		const auto plans = std::make_pair(FFTW(plan_dft_r2c_1d)((int) size, in, spectrum, flagsOf(effort)),
+										  FFTW(plan_dft_c2r_1d)((int) size, spectrum, out, flagsOf(effort)));
+		FFTW(free)(in);
+		FFTW(free)(out);
+		FFTW(free)(spectrum);
+
+		it = registry.insert(std::make_pair(std::make_pair(size, effort), plans)).first;
+	}
+
+	fw = it->second.first;
+	bw = it->second.second;
+}
 
-	_in = fftw_alloc_real(_fftSize);
-	_out = fftw_alloc_real(_fftSize);
-	_spectrum = reinterpret_cast<std::complex<double>*>(fftw_alloc_complex(spectrumSize()));
+void FFTWManager::setPlannerEffort(const PlannerEffort effort)
+{
+	_effort = effort;
+}
 
-	if(plan_fw) fftw_destroy_plan(plan_fw);
-	if(plan_bw) fftw_destroy_plan(plan_bw);
+FFTWManager::PlannerEffort FFTWManager::plannerEffort()
+{
+	return _effort;
+}
 
-	// Initialize the fftw plans
-	plan_fw = fftw_plan_dft_r2c_1d(_fftSize, _in, reinterpret_cast<fftw_complex*>(_spectrum), FFTW_ESTIMATE);
-	plan_bw = fftw_plan_dft_c2r_1d(_fftSize, reinterpret_cast<fftw_complex*>(_spectrum), _out, FFTW_ESTIMATE);
+unsigned int FFTWManager::plannerFlags()
+{
+	return flagsOf(_effort);
+}
+
+std::mutex &FFTWManager::plannerMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+bool FFTWManager::loadWisdom(const std::string &filename)
+{
+	std::lock_guard<std::mutex> lock(plannerMutex());
+	return FFTW(import_wisdom_from_filename)(filename.c_str()) != 0;
+}
+
+bool FFTWManager::saveWisdom(const std::string &filename)
+{
+	std::lock_guard<std::mutex> lock(plannerMutex());
+	return FFTW(export_wisdom_to_filename)(filename.c_str()) != 0;
 }
 
+void FFTWManager::destroy(FFTWManager::Plan &plan)
+{
+	FFTW(free)(plan.in);
+	FFTW(free)(plan.out);
+	FFTW(free)(plan.spectrum);
+}
@@ -1,16 +1,34 @@
 #pragma once
 
 #include "fftmanager.h"
+#include <atomic>
 #include <fftw3.h>
+#include <map>
+#include <mutex>
+#include <string>
 
 /**
  * @brief The FFTWManager class
  *
  * Implementation of the FFTW process.
+ *
+ * Plans are made once per size and planner effort, and shared by all the instances
+ * of the process: they are executed on the buffers of each instance (new-array execute),
+ * which FFTW allows from several threads at once. Only the planner is serialized, by
+ * plannerMutex(). Instances can thus be created, used and destroyed on any thread.
+ * The planner effort and the wisdom are shared by all the instances.
  */
 class FFTWManager : public FFTManager
 {
 	public:
+		/**
+		 * @brief Planner effort, cf. the FFTW planner flags.
+		 *
+		 * Measure and Patient plans are faster, but take much longer to make,
+		 * unless wisdom for the size was loaded with loadWisdom().
+		 */
+		enum class PlannerEffort { Estimate, Measure, Patient };
+
 		FFTWManager();
 		FFTWManager(const FFTWManager& fm);
 		const FFTWManager &operator=(const FFTWManager& fm);
@@ -22,12 +40,86 @@ class FFTWManager : public FFTManager
 		virtual void backward() const override;
 
 		virtual void updateSize(const unsigned int) override;
-		virtual double normalizationFactor() const override;
+		virtual Real normalizationFactor() const override;
+
+		/**
+		 * @brief Effort used for the plans made from now on.
+		 *
+		 * The plans already cached with another effort are made again at the next updateSize().
+		 *
+		 * @param effort Planner effort.
+		 */
+		static void setPlannerEffort(const PlannerEffort effort);
+
+		/**
+		 * @brief Planner effort.
+		 * @return Effort used for new plans.
+		 */
+		static PlannerEffort plannerEffort();
+
+		/**
+		 * @brief FFTW planner flags matching the planner effort.
+		 * @return FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+		 */
+		static unsigned int plannerFlags();
+
+		/**
+		 * @brief Lock of the FFTW planner.
+		 *
+		 * Making or destroying a plan and handling wisdom are not thread-safe in FFTW:
+		 * code making its own plans must hold it meanwhile.
+		 * @return The mutex.
+		 */
+		static std::mutex& plannerMutex();
+
+		/**
+		 * @brief Loads FFTW wisdom, typically at startup.
+		 *
+		 * It is kept for the life of the process.
+		 * @param filename Wisdom file, written by saveWisdom().
+		 * @return True if the file could be read.
+		 */
+		static bool loadWisdom(const std::string& filename);
+
+		/**
+		 * @brief Saves the wisdom accumulated by the plans made until now.
+		 * @param filename Wisdom file.
+		 * @return True if the file could be written.
+		 */
+		static bool saveWisdom(const std::string& filename);
 
 	private:
-		fftw_plan plan_fw = nullptr; /**< TODO */
-		fftw_plan plan_bw = nullptr; /**< TODO */
+		/**
+		 * @brief Buffers of the instance for a given size, and the shared plans used on them.
+		 */
+		struct Plan
+		{
+			Real *in;
+			Real *out;
+			std::complex<Real> *spectrum;
+			FFTW(plan) fw;
+			FFTW(plan) bw;
+			PlannerEffort effort;
+		};
 
-		static unsigned int _num_instances;
-};
+		/**
+		 * @brief Frees the buffers. The plans belong to the process-wide registry.
+		 */
+		static void destroy(Plan& plan);
 
+		/**
+		 * @brief Returns the shared plans of a size, made on first use.
+		 *
+		 * @param size FFT size.
+		 * @param effort Planner effort.
+		 * @param fw Forward plan.
+		 * @param bw Backward plan.
+		 */
+		static void sharedPlans(const unsigned int size, const PlannerEffort effort, FFTW(plan)& fw, FFTW(plan)& bw);
+
+		std::map<unsigned int, Plan> _plans = std::map<unsigned int, Plan>(); /**< Cache, one entry per size */
+		FFTW(plan) plan_fw = nullptr; /**< Forward plan of the current size */
+		FFTW(plan) plan_bw = nullptr; /**< Backward plan of the current size */
+
+		static std::atomic<PlannerEffort> _effort;
+};
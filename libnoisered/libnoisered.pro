@@ -4,7 +4,23 @@ TARGET = noisered
 TEMPLATE = lib
 CONFIG += staticlib c++11
 DESTDIR = $$PWD/../output
-LIBS += -lcwt -lfftw3
+LIBS += -lfftw3
+
+# Single precision processing path (fftwf). Must be the same for the library and its users.
+CONFIG(float) {
+DEFINES += NOISERED_FLOAT
+LIBS += -lfftw3f
+}
+
+# Equal-loudness reference points compiled in, instead of read from 60phon/loudness_real.data.
+CONFIG(builtin_loudness) {
+DEFINES += NOISERED_BUILTIN_LOUDNESS
+}
+
+# Timings of the stages of each frame, see profiler.h. Without it, nothing is measured.
+CONFIG(profiling) {
+DEFINES += NOISERED_PROFILING
+}
 
 contains(QMAKE_TARGET.arch, 64):{
 msvc:QMAKE_CXXFLAGS_RELEASE += -openmp -arch:AVX
@@ -39,19 +55,27 @@ SOURCES += \
 	estimation/wavelets/matrix.cpp \
 	eval.cpp \
 	estimation/wavelets/cwt_noise_estimator.cpp \
+	estimation/wavelets/morlet_cwt.cpp \
 	estimation/wavelets/area.cpp \
+	estimation/wavelets/area_labeller.cpp \
 	subtraction/simple_ss.cpp \
 	subtraction/el_ss.cpp \
 	subtraction/geometric_ss.cpp \
+	subtraction/loudness_contour.cpp \
 	estimation/estimation_algorithm.cpp \
 	subtraction/subtraction_algorithm.cpp \
 	estimation/simple_estimation.cpp \
 	estimation/martin_estimation.cpp \
 	estimation/wavelet_estimation.cpp \
 	subtraction_manager.cpp \
+	multichannel_subtraction_manager.cpp \
+	mapped_file.cpp \
+	profiler.cpp \
 	mathutils/math_util.cpp \
+	mathutils/subtraction_kernels.cpp \
 	fft/fftmanager.cpp \
-	fft/fftwmanager.cpp
+	fft/fftwmanager.cpp \
+	fft/fftwbatchmanager.cpp
 
 HEADERS += \
 	estimation/wavelets/point.h \
@@ -59,10 +83,13 @@ HEADERS += \
 	estimation/wavelets/matrix.h \
 	eval.h \
 	estimation/wavelets/cwt_noise_estimator.h \
+	estimation/wavelets/morlet_cwt.h \
 	estimation/wavelets/area.h \
+	estimation/wavelets/area_labeller.h \
 	subtraction/simple_ss.h \
 	subtraction/el_ss.h \
 	subtraction/geometric_ss.h \
+	subtraction/loudness_contour.h \
 	estimation/estimation_algorithm.h \
 	subtraction/subtraction_algorithm.h \
 	estimation/simple_estimation.h \
@@ -72,9 +99,15 @@ HEADERS += \
 	estimation/algorithms.h \
 	mathutils/spline.hpp \
 	subtraction_manager.h \
+	multichannel_subtraction_manager.h \
+	mapped_file.h \
+	profiler.h \
 	mathutils/math_util.h \
+	mathutils/real.h \
+	mathutils/subtraction_kernels.h \
 	fft/fftmanager.h \
-	fft/fftwmanager.h
+	fft/fftwmanager.h \
+	fft/fftwbatchmanager.h
 
 #Learning:
 #SOURCES += \
@@ -0,0 +1,68 @@
+#include <fstream>
+#include <iostream>
+
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char *path)
+{
+#ifdef MAPPED_FILE_MMAP
+	const int fd = open(path, O_RDONLY);
+	if (fd >= 0)
+	{
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+		{
+			void * const addr = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr != MAP_FAILED)
+			{
+				// The frames are read in order: let the system read ahead and drop pages behind
+				madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+				_data = static_cast<const char *>(addr);
+				_size = (size_t) st.st_size;
+				_mapped = true;
+			}
+		}
+		close(fd);
+		if (_mapped) return;
+	}
+#endif
+
+	std::ifstream ifile(path, std::ios_base::ate | std::ios_base::binary);
+	const std::streamoff length = ifile.tellg();
+	if (!ifile || length < 0)
+	{
+		std::cerr << "Could not open " << path << std::endl;
+		return;
+	}
+
+	_copy.resize(((size_t) length + 1) / 2);
+	ifile.seekg(0, std::ios_base::beg);
+	ifile.read(reinterpret_cast<char *>(_copy.data()), length);
+	_size = (size_t) ifile.gcount();
+	_data = _size ? reinterpret_cast<const char *>(_copy.data()) : nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef MAPPED_FILE_MMAP
+	if (_mapped) munmap(const_cast<char *>(_data), _size);
+#endif
+}
+
+const char *MappedFile::data() const
+{
+	return _data;
+}
+
+size_t MappedFile::size() const
+{
+	return _size;
+}
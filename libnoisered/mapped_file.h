@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Read-only view of a whole file, memory-mapped when possible.
+ *
+ * Pages are only read from the disk when they are accessed, and can be
+ * dropped by the system afterwards: a frame loop going through the file
+ * only keeps a few frames in memory. Files that cannot be mapped (e.g. on
+ * systems without mmap) are read into memory instead.
+ */
+class MappedFile
+{
+	public:
+		/**
+		 * @brief Opens and maps a file.
+		 *
+		 * @param path Path to the file. If it can not be opened, the view is empty.
+		 */
+		explicit MappedFile(const char * path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		 * @brief Returns the content of the file.
+		 *
+		 * @return const char* First byte, aligned for any type. nullptr if the file is empty.
+		 */
+		const char *data() const;
+
+		/**
+		 * @brief Returns the size of the file.
+		 *
+		 * @return size_t Size in bytes.
+		 */
+		size_t size() const;
+
+	private:
+		const char *_data = nullptr;
+		size_t _size = 0;
+		bool _mapped = false;
+		std::vector<short> _copy = std::vector<short>(); /**< Content when the file is not mapped */
+};
@@ -5,46 +5,44 @@
 
 namespace MathUtil
 {
-	double CplxToPower(const std::complex<double> val)
+	Real CplxToPower(const std::complex<Real> val)
 	{
 		return std::norm(val);
 	}
 
-	double CplxToPhase(const std::complex<double> val)
+	Real CplxToPhase(const std::complex<Real> val)
 	{
 		return std::arg(val);
 	}
 
-	double energy(const double * tab, const unsigned int length)
+	double energy(const Real * tab, const unsigned int length)
 	{
-		return mapReduce_n(tab, length, 0.0, [] (double x) { return std::pow(x, 2);}, std::plus<double>());
+		return mapReduce_n(tab, length, 0.0, [] (Real x) { return (double) x * x;}, std::plus<double>());
 	}
 
-	double abssum(const double * tab, const unsigned int length)
+	double abssum(const Real * tab, const unsigned int length)
 	{
-		return mapReduce_n(tab, length, 0.0, [] (double x) { return std::abs(x); },  std::plus<double>());
+		return mapReduce_n(tab, length, 0.0, [] (Real x) { return (double) std::abs(x); },  std::plus<double>());
 	}
 
-	void computePowerAndPhaseSpectrum(const std::complex<double> * const in, double * const powoutput, double * const phaseoutput, const unsigned int size)
+	void computePowerAndPhaseSpectrum(const std::complex<Real> * const in, Real * const powoutput, Real * const phaseoutput, const unsigned int size)
 	{
 		std::transform(in, in + size, powoutput, CplxToPower);
 		std::transform(in, in + size, phaseoutput, CplxToPhase);
 	}
 
-	void computePowerSpectrum(const std::complex<double> * const in, double * const powoutput, const unsigned int size)
+	void computePowerSpectrum(const std::complex<Real> * const in, Real * const powoutput, const unsigned int size)
 	{
 		std::transform(in, in + size, powoutput, CplxToPower);
 	}
 
-	double ShortToDouble(const short x)
+	Real ShortToDouble(const short x)
 	{
-		const double normalizationFactor = 1.0 / std::pow(2, sizeof(short) * 8 - 1);
-		return x * normalizationFactor;
+		return x * (Real(1) / 32768);
 	}
 
-	short DoubleToShort(const double x)
+	short DoubleToShort(const Real x)
 	{
-		const unsigned int denormalizationFactor = (int) std::pow(2, sizeof(short) * 8 - 1);
-		return (short) (x * denormalizationFactor);
+		return (short) std::max(Real(-32768), std::min(x * 32768, Real(32767)));
 	}
 }
@@ -3,6 +3,7 @@
 #include <functional>
 #include <iterator>
 #include <type_traits>
+#include "real.h"
 //! Mathematic utilities.
 namespace MathUtil
 {
@@ -11,14 +12,14 @@ namespace MathUtil
 	 * @param val Complex value
 	 * @return x^2 + y^2
 	 */
-	double CplxToPower(const std::complex<double> val);
+	Real CplxToPower(const std::complex<Real> val);
 
 	/**
 	 * @brief Converts a complex into a double corresponding to its phase.
 	 * @param val Complex value
 	 * @return arc tan(y, x)
 	 */
-	double CplxToPhase(const std::complex<double> val);
+	Real CplxToPhase(const std::complex<Real> val);
 
 
 
@@ -30,7 +31,7 @@ namespace MathUtil
 	 * @param phaseoutput Phase output.
 	 * @param size Size of array.
 	 */
-	void computePowerAndPhaseSpectrum(const std::complex<double> * const in, double * const powoutput, double * const phaseoutput, const unsigned int size);
+	void computePowerAndPhaseSpectrum(const std::complex<Real> * const in, Real * const powoutput, Real * const phaseoutput, const unsigned int size);
 
 
 	/**
@@ -111,7 +112,7 @@ namespace MathUtil
 	 * @param powoutput Power output.
 	 * @param size Size of array.
 	 */
-	void computePowerSpectrum(const std::complex<double> * const in, double * const powoutput, const unsigned int size);
+	void computePowerSpectrum(const std::complex<Real> * const in, Real * const powoutput, const unsigned int size);
 
 	/**
 	 * @brief energy Returns the average energy for a full spectrum
@@ -120,7 +121,7 @@ namespace MathUtil
 	 * @param length Length of tab
 	 * @return Energy
 	 */
-	double energy(const double *tab, const unsigned int length);
+	double energy(const Real *tab, const unsigned int length);
 
 	/**
 	 * @brief abssum Returns the sum of the absolute values in an array
@@ -129,21 +130,25 @@ namespace MathUtil
 	 * @param length Length of tab
 	 * @return Sum of the absolute values
 	 */
-	double abssum(const double *tab, const unsigned int length);
+	double abssum(const Real *tab, const unsigned int length);
 
 	/**
-	 * @brief Puts a signed 16bit integer (red book) between the -1 / 1 range in double.
+	 * @brief Puts a signed 16bit integer (red book) between the -1 / 1 range in floating point.
+	 *
+	 * See also shortToReal, for arrays.
 	 *
 	 * @param x Integer to convert.
-	 * @return double Corresponding floating point value.
+	 * @return Real Corresponding floating point value.
 	 */
-	double ShortToDouble(const short x);
+	Real ShortToDouble(const short x);
 	/**
-	 * @brief Puts a double between -1 and 1 into a 16 bit signed integer (red book).
+	 * @brief Puts a floating point value between -1 and 1 into a 16 bit signed integer (red book).
+	 *
+	 * Values out of range saturate. See also realToShort, for arrays.
 	 *
-	 * @param x Double to convert.
+	 * @param x Value to convert.
 	 * @return short Corresponding short value.
 	 */
-	short DoubleToShort(const double x);
+	short DoubleToShort(const Real x);
 
 }
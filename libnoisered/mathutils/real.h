@@ -0,0 +1,23 @@
+#pragma once
+
+/**
+ * @brief Floating-point type of the whole processing path.
+ *
+ * double by default. Building with NOISERED_FLOAT defined (CONFIG += float
+ * in the .pro files) switches the buffers, the estimators, the subtraction
+ * algorithms and the FFT (fftwf) to single precision: 16 bit audio does not
+ * need more, and it doubles the SIMD width.
+ *
+ * The library and the programs including its headers must agree on it.
+ */
+#ifdef NOISERED_FLOAT
+typedef float Real;
+
+//! Prefixes a FFTW identifier: fftwf_ or fftw_ according to the precision.
+#define FFTW(name) fftwf_ ## name
+#else
+typedef double Real;
+
+//! Prefixes a FFTW identifier: fftwf_ or fftw_ according to the precision.
+#define FFTW(name) fftw_ ## name
+#endif
@@ -17,14 +17,11 @@
 
 #pragma once
 
-#include <boost/numeric/ublas/vector.hpp>
-#include <boost/numeric/ublas/vector_proxy.hpp>
-#include <boost/numeric/ublas/matrix.hpp>
-#include <boost/numeric/ublas/triangular.hpp>
-#include <boost/numeric/ublas/lu.hpp>
-#include <exception>
-
-namespace ublas = boost::numeric::ublas;
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace MathUtil
 {
@@ -50,7 +47,7 @@ class Spline : private std::vector<std::pair<double, double> >
 		//end points
 		Spline():
 			_data(std::vector<SplineData>()),
-			_ddy(ublas::vector<double>()),
+			_ddy(std::vector<double>()),
 			_valid(false),
 			_BCLow(FIXED_2ND_DERIV_BC), _BCHigh(FIXED_2ND_DERIV_BC),
 			_BCLowVal(0), _BCHighVal(0),
@@ -68,7 +65,7 @@ class Spline : private std::vector<std::pair<double, double> >
 		//Standard STL read-only container stuff
 		const_iterator begin() const { return base::begin(); }
 		const_iterator end() const { return base::end(); }
-		void clear() { _valid = false; base::clear(); _data.clear(); }
+		void clear() { _valid = false; base::clear(); _data.clear(); _ddy.clear(); }
 		size_t size() const { return base::size(); }
 		size_t max_size() const { return base::max_size(); }
 		size_t capacity() const { return base::capacity(); }
@@ -112,6 +109,48 @@ class Spline : private std::vector<std::pair<double, double> >
 			return splineCalc(_data.end() - 1, xval);
 		}
 
+		//Evaluates the spline at n points sorted in ascending order.
+		//Gives the same values as operator() on each point, but walks
+		//the intervals once and runs a vectorized loop on each interval.
+		//xs and out may be the same array.
+		void evaluate(const double * const xs, double * const out, const size_t n)
+		{
+			if (!_valid) { generate(); }
+
+			const double xLow = x(0);
+			const double xHigh = x(size() - 1);
+
+			size_t k = 0;
+			for (; k < n && xs[k] <= xLow; ++k)
+				out[k] = lowCalc(xs[k]);
+
+			//Same intervals as operator(): ]x(i), x(i + 1)], the last one
+			//is open on both sides
+			for (size_t i = 0; i < _data.size() && k < n; ++i)
+			{
+				const bool last = i + 1 == _data.size();
+				const double upper = last ? xHigh : _data[i + 1].x;
+
+				size_t end = k;
+				while (end < n && (last ? xs[end] < upper : xs[end] <= upper))
+					++end;
+
+				const double xi = _data[i].x;
+				const double a = _data[i].a, b = _data[i].b, c = _data[i].c, d = _data[i].d;
+
+				#pragma omp simd
+				for (size_t j = k; j < end; ++j)
+				{
+					const double lx = xs[j] - xi;
+					out[j] = ((a * lx + b) * lx + c) * lx + d;
+				}
+				k = end;
+			}
+
+			for (; k < n; ++k)
+				out[k] = highCalc(xs[k]);
+		}
+
 	private:
 
 		///////PRIVATE DATA MEMBERS
@@ -119,7 +158,7 @@ class Spline : private std::vector<std::pair<double, double> >
 		//vector of calculated spline data
 		std::vector<SplineData> _data;
 		//Second derivative at each point
-		ublas::vector<double> _ddy;
+		std::vector<double> _ddy;
 		//Tracks whether the spline parameters have been calculated for
 		//the current set of points
 		bool _valid;
@@ -193,29 +232,6 @@ class Spline : private std::vector<std::pair<double, double> >
 		inline double y(size_t i) const { return operator[](i).second; }
 		inline double h(size_t i) const { return x(i + 1) - x(i); }
 
-		//Invert a arbitrary matrix using the boost ublas library
-		template<class T>
-		bool InvertMatrix(ublas::matrix<T> A,
-						  ublas::matrix<T> &inverse)
-		{
-			using namespace ublas;
-
-			// create a permutation matrix for the LU-factorization
-			permutation_matrix<std::size_t> pm(A.size1());
-
-			// perform LU-factorization
-			auto res = lu_factorize(A, pm);
-			if (res != 0) { return false; }
-
-			// create identity matrix of "inverse"
-			inverse.assign(ublas::identity_matrix<T>(A.size1()));
-
-			// backsubstitute to get the inverse
-			lu_substitute(A, pm, inverse);
-
-			return true;
-		}
-
 		//This function will recalculate the spline parameters and store
 		//them in _data, ready for spline interpolation
 		void generate()
@@ -251,6 +267,7 @@ class Spline : private std::vector<std::pair<double, double> >
 			}
 
 			const size_t e = size() - 1;
+			_data.resize(e);
 
 			switch (_type)
 			{
@@ -258,7 +275,6 @@ class Spline : private std::vector<std::pair<double, double> >
 					break;
 				case LINEAR:
 				{
-					_data.resize(e);
 					for (size_t i(0); i < e; ++i)
 					{
 						_data[i].x = x(i);
@@ -271,89 +287,97 @@ class Spline : private std::vector<std::pair<double, double> >
 				}
 				case CUBIC:
 				{
-					ublas::matrix<double> A(size(), size());
-					for (size_t yv(0); yv <= e; ++yv)
-						for (size_t xv(0); xv <= e; ++xv)
-						{
-							A(xv, yv) = 0;
-						}
-
-					for (size_t i(1); i < e; ++i)
-					{
-						A(i - 1, i) = h(i - 1);
-						A(i, i) = 2 * (h(i - 1) + h(i));
-						A(i + 1, i) = h(i);
-					}
+					solveSecondDerivatives();
 
-					ublas::vector<double> C(size());
-					for (size_t xv(0); xv <= e; ++xv)
+					for (size_t i(0); i < e; ++i)
 					{
-						C(xv) = 0;
+						_data[i].x = x(i);
+						_data[i].a = (_ddy[i + 1] - _ddy[i]) / (6 * h(i));
+						_data[i].b = _ddy[i] / 2;
+						_data[i].c = (y(i + 1) - y(i)) / h(i) - _ddy[i + 1] * h(i) / 6 - _ddy[i] * h(i) / 3;
+						_data[i].d = y(i);
 					}
+				}
+			}
+			_valid = true;
+		}
 
-					for (size_t i(1); i < e; ++i)
-						C(i) = 6 *
-							   ((y(i + 1) - y(i)) / h(i)
-								- (y(i) - y(i - 1)) / h(i - 1));
+		//Solves the tridiagonal system of the second derivatives with
+		//the Thomas algorithm. Equation i is
+		//  sub * ddy(i - 1) + diag * ddy(i) + sup * ddy(i + 1) = rhs
+		//The modified upper diagonal is kept in _data[i].c until the
+		//coefficients are computed, so nothing is allocated once _data
+		//and _ddy have the size of the spline.
+		void solveSecondDerivatives()
+		{
+			const size_t e = size() - 1;
+			_ddy.resize(size());
 
-					//Boundary conditions
-					switch (_BCLow)
-					{
-						default:
-							break;
-						case FIXED_1ST_DERIV_BC:
-							C(0) = 6 * ((y(1) - y(0)) / h(0) - _BCLowVal);
-							A(0, 0) = 2 * h(0);
-							A(1, 0) = h(0);
-							break;
-						case FIXED_2ND_DERIV_BC:
-							C(0) = _BCLowVal;
-							A(0, 0) = 1;
-							break;
-						case PARABOLIC_RUNOUT_BC:
-							C(0) = 0;
-							A(0, 0) = 1;
-							A(1, 0) = -1;
-							break;
-					}
+			//First row: boundary condition
+			double diag = 1, sup = 0, rhs = 0;
+			switch (_BCLow)
+			{
+				default:
+					break;
+				case FIXED_1ST_DERIV_BC:
+					rhs = 6 * ((y(1) - y(0)) / h(0) - _BCLowVal);
+					diag = 2 * h(0);
+					sup = h(0);
+					break;
+				case FIXED_2ND_DERIV_BC:
+					rhs = _BCLowVal;
+					break;
+				case PARABOLIC_RUNOUT_BC:
+					sup = -1;
+					break;
+			}
+			_data[0].c = sup / diag;
+			_ddy[0] = rhs / diag;
 
+			//Forward sweep
+			for (size_t i(1); i <= e; ++i)
+			{
+				double sub;
+				if (i < e)
+				{
+					sub = h(i - 1);
+					diag = 2 * (h(i - 1) + h(i));
+					sup = h(i);
+					rhs = 6 * ((y(i + 1) - y(i)) / h(i) - (y(i) - y(i - 1)) / h(i - 1));
+				}
+				else
+				{
+					//Last row: boundary condition
+					sub = 0;
+					diag = 1;
+					sup = 0;
+					rhs = 0;
 					switch (_BCHigh)
 					{
 						default:
 							break;
 						case FIXED_1ST_DERIV_BC:
-							C(e) = 6 * (_BCHighVal - (y(e) - y(e - 1)) / h(e - 1));
-							A(e, e) = 2 * h(e - 1);
-							A(e - 1, e) = h(e - 1);
+							rhs = 6 * (_BCHighVal - (y(e) - y(e - 1)) / h(e - 1));
+							diag = 2 * h(e - 1);
+							sub = h(e - 1);
 							break;
 						case FIXED_2ND_DERIV_BC:
-							C(e) = _BCHighVal;
-							A(e, e) = 1;
+							rhs = _BCHighVal;
 							break;
 						case PARABOLIC_RUNOUT_BC:
-							C(e) = 0;
-							A(e, e) = 1;
-							A(e - 1, e) = -1;
+							sub = -1;
 							break;
 					}
-
-					ublas::matrix<double> AInv(size(), size());
-					InvertMatrix(A, AInv);
-
-					_ddy = ublas::prod(C, AInv);
-
-					_data.resize(size() - 1);
-					for (size_t i(0); i < e; ++i)
-					{
-						_data[i].x = x(i);
-						_data[i].a = (_ddy(i + 1) - _ddy(i)) / (6 * h(i));
-						_data[i].b = _ddy(i) / 2;
-						_data[i].c = (y(i + 1) - y(i)) / h(i) - _ddy(i + 1) * h(i) / 6 - _ddy(i) * h(i) / 3;
-						_data[i].d = y(i);
-					}
 				}
+
+				const double m = diag - sub * _data[i - 1].c;
+				if (i < e) _data[i].c = sup / m;
+				_ddy[i] = (rhs - sub * _ddy[i - 1]) / m;
 			}
-			_valid = true;
+
+			//Back substitution
+			for (size_t i(e); i-- > 0;)
+				_ddy[i] -= _data[i].c * _ddy[i + 1];
 		}
 };
 }
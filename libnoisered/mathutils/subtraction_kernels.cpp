@@ -0,0 +1,806 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "subtraction_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && (defined(__aarch64__) || defined(NOISERED_FLOAT))
+// ARMv7 NEON has no double precision: it only gets the single precision kernels.
+#define KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	const Real geom_alpha = (Real) 0.98, geom_beta = (Real) 0.98;
+	const Real twentysixdb = (Real) std::pow(10., -26. / 20.);
+	const Real thirteendb = (Real) std::pow(10., -20. / 20.);
+	const Real real_min = std::numeric_limits<Real>::min();
+
+	//*** Scalar kernels, also used for the remaining bins of the vectorized ones ***//
+	inline Real powerSubtractionBin(const std::complex<Real> bin, const Real noise, const Real alpha, const Real beta)
+	{
+		const Real power = std::norm(bin);
+		return std::sqrt(std::max(power - alpha * noise, beta * power) / std::max(power, real_min));
+	}
+
+	inline Real geometricBin(const std::complex<Real> bin, const Real noise, Real& prev_gamma, Real& prev_halfchi)
+	{
+		const Real power = std::norm(bin);
+
+		// Smoothed a posteriori SNR
+		const Real gamma = geom_beta * prev_gamma + (1 - geom_beta) * std::max(thirteendb, power / noise);
+		prev_gamma = gamma;
+
+		// A priori SNR
+		const Real root = std::sqrt(gamma) - 1;
+		const Real chi = std::max(twentysixdb, geom_alpha * prev_halfchi + (1 - geom_alpha) * root * root);
+
+		// Gain
+		const Real u = gamma - chi + 1;
+		const Real v = gamma - 1 - chi;
+		const Real h = std::min(Real(1), std::sqrt((1 - u * u / (4 * gamma)) / (1 - v * v / (4 * chi))));
+
+		prev_halfchi = h * h * power / noise;
+		return h;
+	}
+
+	void powerSubtractionScalar(const std::complex<Real> * const spectrum, const Real * const noise,
+								const Real * const alpha, const Real * const beta, Real * const gain, const unsigned int size)
+	{
+		for (auto i = 0U; i < size; ++i)
+			gain[i] = powerSubtractionBin(spectrum[i], noise[i], alpha[i], beta[i]);
+	}
+
+	void geometricScalar(const std::complex<Real> * const spectrum, const Real * const noise,
+						 Real * const prev_gamma, Real * const prev_halfchi, Real * const gain, const unsigned int size)
+	{
+		for (auto i = 0U; i < size; ++i)
+			gain[i] = geometricBin(spectrum[i], noise[i], prev_gamma[i], prev_halfchi[i]);
+	}
+
+	void applyGainScalar(const std::complex<Real> * const in, std::complex<Real> * const out, Real * const gain,
+						 const Real * const prev_gain, const Real floor, const Real smoothing, const unsigned int size)
+	{
+		for (auto i = 0U; i < size; ++i)
+		{
+			gain[i] = std::max(floor, smoothing * prev_gain[i] + (1 - smoothing) * gain[i]);
+			out[i] = in[i] * gain[i];
+		}
+	}
+
+	void columnMinimumScalar(const Real * const rows, const unsigned int nrows, Real * const out, const unsigned int size)
+	{
+		std::copy(rows, rows + size, out);
+		for (auto j = 1U; j < nrows; ++j)
+		{
+			const Real * const row = rows + j * size;
+			for (auto i = 0U; i < size; ++i)
+				out[i] = std::min(out[i], row[i]);
+		}
+	}
+
+	// Signed 16 bit PCM full scale
+	const Real pcm_scale = 32768;
+
+	inline short realToShortSample(const Real x)
+	{
+		// Saturation, then truncation toward zero
+		return (short) std::max(Real(-32768), std::min(x, Real(32767)));
+	}
+
+	void shortToRealScalar(const short * const in, Real * const out, const unsigned int size)
+	{
+		for (auto i = 0U; i < size; ++i)
+			out[i] = in[i] * (1 / pcm_scale);
+	}
+
+	void realToShortScalar(const Real * const in, short * const out, const Real scale, const unsigned int size)
+	{
+		const Real factor = scale * pcm_scale;
+		for (auto i = 0U; i < size; ++i)
+			out[i] = realToShortSample(in[i] * factor);
+	}
+
+#ifdef KERNELS_AVX2
+#ifdef NOISERED_FLOAT
+	//*** AVX2, single precision: eight bins per iteration ***//
+	__attribute__((target("avx2")))
+	inline __m256 powerAVX2(const __m256 lo, const __m256 hi)
+	{
+		// [r0 i0 .. r3 i3] [r4 i4 .. r7 i7] -> [p0 p1 p4 p5 p2 p3 p6 p7] -> [p0 .. p7]
+		const __m256 sum = _mm256_hadd_ps(_mm256_mul_ps(lo, lo), _mm256_mul_ps(hi, hi));
+		return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), 0xD8));
+	}
+
+	__attribute__((target("avx2")))
+	void powerSubtractionAVX2(const std::complex<float> * const spectrum, const float * const noise,
+							  const float * const alpha, const float * const beta, float * const gain, const unsigned int size)
+	{
+		const float * const bins = reinterpret_cast<const float *>(spectrum);
+		const __m256 flt_min = _mm256_set1_ps(real_min);
+
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			const __m256 lo = _mm256_loadu_ps(bins + 2 * i);
+			const __m256 hi = _mm256_loadu_ps(bins + 2 * i + 8);
+			const __m256 power = powerAVX2(lo, hi);
+
+			const __m256 a = _mm256_sub_ps(power, _mm256_mul_ps(_mm256_loadu_ps(alpha + i), _mm256_loadu_ps(noise + i)));
+			const __m256 b = _mm256_mul_ps(_mm256_loadu_ps(beta + i), power);
+			_mm256_storeu_ps(gain + i, _mm256_sqrt_ps(_mm256_div_ps(_mm256_max_ps(a, b), _mm256_max_ps(power, flt_min))));
+		}
+
+		powerSubtractionScalar(spectrum + i, noise + i, alpha + i, beta + i, gain + i, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void geometricAVX2(const std::complex<float> * const spectrum, const float * const noise,
+					   float * const prev_gamma, float * const prev_halfchi, float * const gain, const unsigned int size)
+	{
+		const float * const bins = reinterpret_cast<const float *>(spectrum);
+		const __m256 one = _mm256_set1_ps(1);
+		const __m256 four = _mm256_set1_ps(4);
+		const __m256 ga = _mm256_set1_ps(geom_alpha), one_ga = _mm256_set1_ps(1 - geom_alpha);
+		const __m256 gb = _mm256_set1_ps(geom_beta), one_gb = _mm256_set1_ps(1 - geom_beta);
+		const __m256 floor26 = _mm256_set1_ps(twentysixdb);
+		const __m256 floor13 = _mm256_set1_ps(thirteendb);
+
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			const __m256 lo = _mm256_loadu_ps(bins + 2 * i);
+			const __m256 hi = _mm256_loadu_ps(bins + 2 * i + 8);
+			const __m256 power = powerAVX2(lo, hi);
+			const __m256 n = _mm256_loadu_ps(noise + i);
+
+			// max(x, floor) returns floor when x is NaN, like std::max(floor, x)
+			const __m256 gammai = _mm256_max_ps(_mm256_div_ps(power, n), floor13);
+			const __m256 gamma = _mm256_add_ps(_mm256_mul_ps(gb, _mm256_loadu_ps(prev_gamma + i)), _mm256_mul_ps(one_gb, gammai));
+			_mm256_storeu_ps(prev_gamma + i, gamma);
+
+			const __m256 root = _mm256_sub_ps(_mm256_sqrt_ps(gamma), one);
+			const __m256 chi = _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(ga, _mm256_loadu_ps(prev_halfchi + i)),
+														   _mm256_mul_ps(one_ga, _mm256_mul_ps(root, root))), floor26);
+
+			const __m256 u = _mm256_add_ps(_mm256_sub_ps(gamma, chi), one);
+			const __m256 v = _mm256_sub_ps(_mm256_sub_ps(gamma, one), chi);
+			const __m256 num = _mm256_sub_ps(one, _mm256_div_ps(_mm256_mul_ps(u, u), _mm256_mul_ps(four, gamma)));
+			const __m256 den = _mm256_sub_ps(one, _mm256_div_ps(_mm256_mul_ps(v, v), _mm256_mul_ps(four, chi)));
+			const __m256 h = _mm256_min_ps(_mm256_sqrt_ps(_mm256_div_ps(num, den)), one);
+
+			_mm256_storeu_ps(prev_halfchi + i, _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(h, h), power), n));
+			_mm256_storeu_ps(gain + i, h);
+		}
+
+		geometricScalar(spectrum + i, noise + i, prev_gamma + i, prev_halfchi + i, gain + i, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void applyGainAVX2(const std::complex<float> * const in, std::complex<float> * const out, float * const gain,
+					   const float * const prev_gain, const float floor, const float smoothing, const unsigned int size)
+	{
+		const float * const src = reinterpret_cast<const float *>(in);
+		float * const dst = reinterpret_cast<float *>(out);
+		const __m256 f = _mm256_set1_ps(floor);
+		const __m256 s = _mm256_set1_ps(smoothing), one_s = _mm256_set1_ps(1 - smoothing);
+		const __m256i first = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+		const __m256i second = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			const __m256 g = _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(s, _mm256_loadu_ps(prev_gain + i)),
+														 _mm256_mul_ps(one_s, _mm256_loadu_ps(gain + i))), f);
+			_mm256_storeu_ps(gain + i, g);
+
+			// [g0 .. g7] -> [g0 g0 .. g3 g3] [g4 g4 .. g7 g7], one gain per complex
+			_mm256_storeu_ps(dst + 2 * i,     _mm256_mul_ps(_mm256_loadu_ps(src + 2 * i),     _mm256_permutevar8x32_ps(g, first)));
+			_mm256_storeu_ps(dst + 2 * i + 8, _mm256_mul_ps(_mm256_loadu_ps(src + 2 * i + 8), _mm256_permutevar8x32_ps(g, second)));
+		}
+
+		applyGainScalar(in + i, out + i, gain + i, prev_gain + i, floor, smoothing, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void columnMinimumAVX2(const float * const rows, const unsigned int nrows, float * const out, const unsigned int size)
+	{
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			// The whole column stays in a register: out is written once
+			__m256 m = _mm256_loadu_ps(rows + i);
+			for (auto j = 1U; j < nrows; ++j)
+				m = _mm256_min_ps(_mm256_loadu_ps(rows + j * size + i), m);
+			_mm256_storeu_ps(out + i, m);
+		}
+
+		for (; i < size; ++i)
+		{
+			float m = rows[i];
+			for (auto j = 1U; j < nrows; ++j)
+				m = std::min(m, rows[j * size + i]);
+			out[i] = m;
+		}
+	}
+
+	__attribute__((target("avx2")))
+	void shortToRealAVX2(const short * const in, float * const out, const unsigned int size)
+	{
+		const __m256 norm = _mm256_set1_ps(1 / pcm_scale);
+
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+			_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), norm));
+		}
+
+		shortToRealScalar(in + i, out + i, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void realToShortAVX2(const float * const in, short * const out, const float scale, const unsigned int size)
+	{
+		const __m256 factor = _mm256_set1_ps(scale * pcm_scale);
+		const __m256 lo = _mm256_set1_ps(-32768), hi = _mm256_set1_ps(32767);
+
+		auto i = 0U;
+		for (; i + 16 <= size; i += 16)
+		{
+			// Clamped before the conversion: out of range values would give INT_MIN
+			const __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), factor), hi), lo);
+			const __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), factor), hi), lo);
+
+			// Packing works per 128 bit lane: [a0-3 b0-3 a4-7 b4-7] -> [a0-7 b0-7]
+			const __m256i p = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permute4x64_epi64(p, 0xD8));
+		}
+
+		realToShortScalar(in + i, out + i, scale, size - i);
+	}
+#else
+	//*** AVX2, double precision: four bins per iteration ***//
+	__attribute__((target("avx2")))
+	inline __m256d powerAVX2(const __m256d lo, const __m256d hi)
+	{
+		// [r0 i0 r1 i1] [r2 i2 r3 i3] -> [p0 p2 p1 p3] -> [p0 p1 p2 p3]
+		const __m256d sum = _mm256_hadd_pd(_mm256_mul_pd(lo, lo), _mm256_mul_pd(hi, hi));
+		return _mm256_permute4x64_pd(sum, 0xD8);
+	}
+
+	__attribute__((target("avx2")))
+	void powerSubtractionAVX2(const std::complex<double> * const spectrum, const double * const noise,
+							  const double * const alpha, const double * const beta, double * const gain, const unsigned int size)
+	{
+		const double * const bins = reinterpret_cast<const double *>(spectrum);
+		const __m256d dbl_min = _mm256_set1_pd(real_min);
+
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			const __m256d lo = _mm256_loadu_pd(bins + 2 * i);
+			const __m256d hi = _mm256_loadu_pd(bins + 2 * i + 4);
+			const __m256d power = powerAVX2(lo, hi);
+
+			const __m256d a = _mm256_sub_pd(power, _mm256_mul_pd(_mm256_loadu_pd(alpha + i), _mm256_loadu_pd(noise + i)));
+			const __m256d b = _mm256_mul_pd(_mm256_loadu_pd(beta + i), power);
+			_mm256_storeu_pd(gain + i, _mm256_sqrt_pd(_mm256_div_pd(_mm256_max_pd(a, b), _mm256_max_pd(power, dbl_min))));
+		}
+
+		powerSubtractionScalar(spectrum + i, noise + i, alpha + i, beta + i, gain + i, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void geometricAVX2(const std::complex<double> * const spectrum, const double * const noise,
+					   double * const prev_gamma, double * const prev_halfchi, double * const gain, const unsigned int size)
+	{
+		const double * const bins = reinterpret_cast<const double *>(spectrum);
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d four = _mm256_set1_pd(4.0);
+		const __m256d ga = _mm256_set1_pd(geom_alpha), one_ga = _mm256_set1_pd(1.0 - geom_alpha);
+		const __m256d gb = _mm256_set1_pd(geom_beta), one_gb = _mm256_set1_pd(1.0 - geom_beta);
+		const __m256d floor26 = _mm256_set1_pd(twentysixdb);
+		const __m256d floor13 = _mm256_set1_pd(thirteendb);
+
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			const __m256d lo = _mm256_loadu_pd(bins + 2 * i);
+			const __m256d hi = _mm256_loadu_pd(bins + 2 * i + 4);
+			const __m256d power = powerAVX2(lo, hi);
+			const __m256d n = _mm256_loadu_pd(noise + i);
+
+			// max(x, floor) returns floor when x is NaN, like std::max(floor, x)
+			const __m256d gammai = _mm256_max_pd(_mm256_div_pd(power, n), floor13);
+			const __m256d gamma = _mm256_add_pd(_mm256_mul_pd(gb, _mm256_loadu_pd(prev_gamma + i)), _mm256_mul_pd(one_gb, gammai));
+			_mm256_storeu_pd(prev_gamma + i, gamma);
+
+			const __m256d root = _mm256_sub_pd(_mm256_sqrt_pd(gamma), one);
+			const __m256d chi = _mm256_max_pd(_mm256_add_pd(_mm256_mul_pd(ga, _mm256_loadu_pd(prev_halfchi + i)),
+															_mm256_mul_pd(one_ga, _mm256_mul_pd(root, root))), floor26);
+
+			const __m256d u = _mm256_add_pd(_mm256_sub_pd(gamma, chi), one);
+			const __m256d v = _mm256_sub_pd(_mm256_sub_pd(gamma, one), chi);
+			const __m256d num = _mm256_sub_pd(one, _mm256_div_pd(_mm256_mul_pd(u, u), _mm256_mul_pd(four, gamma)));
+			const __m256d den = _mm256_sub_pd(one, _mm256_div_pd(_mm256_mul_pd(v, v), _mm256_mul_pd(four, chi)));
+			const __m256d h = _mm256_min_pd(_mm256_sqrt_pd(_mm256_div_pd(num, den)), one);
+
+			_mm256_storeu_pd(prev_halfchi + i, _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(h, h), power), n));
+			_mm256_storeu_pd(gain + i, h);
+		}
+
+		geometricScalar(spectrum + i, noise + i, prev_gamma + i, prev_halfchi + i, gain + i, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void applyGainAVX2(const std::complex<double> * const in, std::complex<double> * const out, double * const gain,
+					   const double * const prev_gain, const double floor, const double smoothing, const unsigned int size)
+	{
+		const double * const src = reinterpret_cast<const double *>(in);
+		double * const dst = reinterpret_cast<double *>(out);
+		const __m256d f = _mm256_set1_pd(floor);
+		const __m256d s = _mm256_set1_pd(smoothing), one_s = _mm256_set1_pd(1.0 - smoothing);
+
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			const __m256d g = _mm256_max_pd(_mm256_add_pd(_mm256_mul_pd(s, _mm256_loadu_pd(prev_gain + i)),
+														  _mm256_mul_pd(one_s, _mm256_loadu_pd(gain + i))), f);
+			_mm256_storeu_pd(gain + i, g);
+
+			// [g0 g1 g2 g3] -> [g0 g0 g1 g1] [g2 g2 g3 g3], one gain per complex
+			_mm256_storeu_pd(dst + 2 * i,     _mm256_mul_pd(_mm256_loadu_pd(src + 2 * i),     _mm256_permute4x64_pd(g, 0x50)));
+			_mm256_storeu_pd(dst + 2 * i + 4, _mm256_mul_pd(_mm256_loadu_pd(src + 2 * i + 4), _mm256_permute4x64_pd(g, 0xFA)));
+		}
+
+		applyGainScalar(in + i, out + i, gain + i, prev_gain + i, floor, smoothing, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void columnMinimumAVX2(const double * const rows, const unsigned int nrows, double * const out, const unsigned int size)
+	{
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			// The whole column stays in a register: out is written once
+			__m256d m = _mm256_loadu_pd(rows + i);
+			for (auto j = 1U; j < nrows; ++j)
+				m = _mm256_min_pd(_mm256_loadu_pd(rows + j * size + i), m);
+			_mm256_storeu_pd(out + i, m);
+		}
+
+		for (; i < size; ++i)
+		{
+			double m = rows[i];
+			for (auto j = 1U; j < nrows; ++j)
+				m = std::min(m, rows[j * size + i]);
+			out[i] = m;
+		}
+	}
+
+	__attribute__((target("avx2")))
+	void shortToRealAVX2(const short * const in, double * const out, const unsigned int size)
+	{
+		const __m256d norm = _mm256_set1_pd(1 / pcm_scale);
+
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+			_mm256_storeu_pd(out + i,     _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_cvtepi16_epi32(x)), norm));
+			_mm256_storeu_pd(out + i + 4, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_srli_si128(x, 8))), norm));
+		}
+
+		shortToRealScalar(in + i, out + i, size - i);
+	}
+
+	__attribute__((target("avx2")))
+	void realToShortAVX2(const double * const in, short * const out, const double scale, const unsigned int size)
+	{
+		const __m256d factor = _mm256_set1_pd(scale * pcm_scale);
+		const __m256d lo = _mm256_set1_pd(-32768), hi = _mm256_set1_pd(32767);
+
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			// Clamped before the conversion: out of range values would give INT_MIN
+			const __m256d a = _mm256_max_pd(_mm256_min_pd(_mm256_mul_pd(_mm256_loadu_pd(in + i), factor), hi), lo);
+			const __m256d b = _mm256_max_pd(_mm256_min_pd(_mm256_mul_pd(_mm256_loadu_pd(in + i + 4), factor), hi), lo);
+
+			const __m128i p = _mm_packs_epi32(_mm256_cvttpd_epi32(a), _mm256_cvttpd_epi32(b));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), p);
+		}
+
+		realToShortScalar(in + i, out + i, scale, size - i);
+	}
+#endif
+#endif
+
+#ifdef KERNELS_NEON
+#ifdef NOISERED_FLOAT
+	//*** NEON, single precision (ARMv7 and AArch64): four bins per iteration, deinterleaved loads ***//
+	// Comparisons and selects instead of vmax / vmin: same NaN handling as std::max / std::min,
+	// and vmaxnm is not available on ARMv7.
+	inline float32x4_t maxOf(const float32x4_t a, const float32x4_t b)
+	{
+		return vbslq_f32(vcltq_f32(a, b), b, a);
+	}
+
+	inline float32x4_t minOf(const float32x4_t a, const float32x4_t b)
+	{
+		return vbslq_f32(vcltq_f32(b, a), b, a);
+	}
+
+	inline float32x4_t divide(const float32x4_t a, const float32x4_t b)
+	{
+#ifdef __aarch64__
+		return vdivq_f32(a, b);
+#else
+		// Reciprocal estimate and two Newton-Raphson steps: full single precision
+		float32x4_t r = vrecpeq_f32(b);
+		r = vmulq_f32(vrecpsq_f32(b, r), r);
+		r = vmulq_f32(vrecpsq_f32(b, r), r);
+		return vmulq_f32(a, r);
+#endif
+	}
+
+	inline float32x4_t squareRoot(const float32x4_t x)
+	{
+#ifdef __aarch64__
+		return vsqrtq_f32(x);
+#else
+		// x * 1 / sqrt(x), refined twice; 0 would give 0 * inf
+		float32x4_t r = vrsqrteq_f32(x);
+		r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(x, r), r), r);
+		r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(x, r), r), r);
+		return vbslq_f32(vceqq_f32(x, vdupq_n_f32(0)), x, vmulq_f32(x, r));
+#endif
+	}
+
+	void powerSubtractionNEON(const std::complex<float> * const spectrum, const float * const noise,
+							  const float * const alpha, const float * const beta, float * const gain, const unsigned int size)
+	{
+		const float * const bins = reinterpret_cast<const float *>(spectrum);
+		const float32x4_t flt_min = vdupq_n_f32(real_min);
+
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			const float32x4x2_t c = vld2q_f32(bins + 2 * i);
+			const float32x4_t power = vaddq_f32(vmulq_f32(c.val[0], c.val[0]), vmulq_f32(c.val[1], c.val[1]));
+
+			const float32x4_t a = vsubq_f32(power, vmulq_f32(vld1q_f32(alpha + i), vld1q_f32(noise + i)));
+			const float32x4_t b = vmulq_f32(vld1q_f32(beta + i), power);
+			vst1q_f32(gain + i, squareRoot(divide(maxOf(a, b), maxOf(power, flt_min))));
+		}
+
+		powerSubtractionScalar(spectrum + i, noise + i, alpha + i, beta + i, gain + i, size - i);
+	}
+
+	void geometricNEON(const std::complex<float> * const spectrum, const float * const noise,
+					   float * const prev_gamma, float * const prev_halfchi, float * const gain, const unsigned int size)
+	{
+		const float * const bins = reinterpret_cast<const float *>(spectrum);
+		const float32x4_t one = vdupq_n_f32(1);
+		const float32x4_t four = vdupq_n_f32(4);
+		const float32x4_t ga = vdupq_n_f32(geom_alpha), one_ga = vdupq_n_f32(1 - geom_alpha);
+		const float32x4_t gb = vdupq_n_f32(geom_beta), one_gb = vdupq_n_f32(1 - geom_beta);
+		const float32x4_t floor26 = vdupq_n_f32(twentysixdb);
+		const float32x4_t floor13 = vdupq_n_f32(thirteendb);
+
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			const float32x4x2_t c = vld2q_f32(bins + 2 * i);
+			const float32x4_t power = vaddq_f32(vmulq_f32(c.val[0], c.val[0]), vmulq_f32(c.val[1], c.val[1]));
+			const float32x4_t n = vld1q_f32(noise + i);
+
+			const float32x4_t gammai = maxOf(floor13, divide(power, n));
+			const float32x4_t gamma = vaddq_f32(vmulq_f32(gb, vld1q_f32(prev_gamma + i)), vmulq_f32(one_gb, gammai));
+			vst1q_f32(prev_gamma + i, gamma);
+
+			const float32x4_t root = vsubq_f32(squareRoot(gamma), one);
+			const float32x4_t chi = maxOf(floor26, vaddq_f32(vmulq_f32(ga, vld1q_f32(prev_halfchi + i)),
+															 vmulq_f32(one_ga, vmulq_f32(root, root))));
+
+			const float32x4_t u = vaddq_f32(vsubq_f32(gamma, chi), one);
+			const float32x4_t v = vsubq_f32(vsubq_f32(gamma, one), chi);
+			const float32x4_t num = vsubq_f32(one, divide(vmulq_f32(u, u), vmulq_f32(four, gamma)));
+			const float32x4_t den = vsubq_f32(one, divide(vmulq_f32(v, v), vmulq_f32(four, chi)));
+			const float32x4_t h = minOf(one, squareRoot(divide(num, den)));
+
+			vst1q_f32(prev_halfchi + i, divide(vmulq_f32(vmulq_f32(h, h), power), n));
+			vst1q_f32(gain + i, h);
+		}
+
+		geometricScalar(spectrum + i, noise + i, prev_gamma + i, prev_halfchi + i, gain + i, size - i);
+	}
+
+	void applyGainNEON(const std::complex<float> * const in, std::complex<float> * const out, float * const gain,
+					   const float * const prev_gain, const float floor, const float smoothing, const unsigned int size)
+	{
+		const float * const src = reinterpret_cast<const float *>(in);
+		float * const dst = reinterpret_cast<float *>(out);
+		const float32x4_t f = vdupq_n_f32(floor);
+		const float32x4_t s = vdupq_n_f32(smoothing), one_s = vdupq_n_f32(1 - smoothing);
+
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			const float32x4_t g = maxOf(f, vaddq_f32(vmulq_f32(s, vld1q_f32(prev_gain + i)),
+													 vmulq_f32(one_s, vld1q_f32(gain + i))));
+			vst1q_f32(gain + i, g);
+
+			float32x4x2_t c = vld2q_f32(src + 2 * i);
+			c.val[0] = vmulq_f32(c.val[0], g);
+			c.val[1] = vmulq_f32(c.val[1], g);
+			vst2q_f32(dst + 2 * i, c);
+		}
+
+		applyGainScalar(in + i, out + i, gain + i, prev_gain + i, floor, smoothing, size - i);
+	}
+
+	void columnMinimumNEON(const float * const rows, const unsigned int nrows, float * const out, const unsigned int size)
+	{
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			float32x4_t m = vld1q_f32(rows + i);
+			for (auto j = 1U; j < nrows; ++j)
+				m = minOf(m, vld1q_f32(rows + j * size + i));
+			vst1q_f32(out + i, m);
+		}
+
+		for (; i < size; ++i)
+		{
+			float m = rows[i];
+			for (auto j = 1U; j < nrows; ++j)
+				m = std::min(m, rows[j * size + i]);
+			out[i] = m;
+		}
+	}
+
+	void shortToRealNEON(const short * const in, float * const out, const unsigned int size)
+	{
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			const int16x8_t x = vld1q_s16(in + i);
+			vst1q_f32(out + i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1 / pcm_scale));
+			vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), 1 / pcm_scale));
+		}
+
+		shortToRealScalar(in + i, out + i, size - i);
+	}
+
+	void realToShortNEON(const float * const in, short * const out, const float scale, const unsigned int size)
+	{
+		const float factor = scale * pcm_scale;
+
+		auto i = 0U;
+		for (; i + 8 <= size; i += 8)
+		{
+			// The conversion truncates and saturates, the narrowing saturates again to 16 bits
+			const int32x4_t a = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), factor));
+			const int32x4_t b = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4), factor));
+			vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+		}
+
+		realToShortScalar(in + i, out + i, scale, size - i);
+	}
+#else
+	//*** NEON, double precision (AArch64 only): two bins per iteration, deinterleaved loads ***//
+	void powerSubtractionNEON(const std::complex<double> * const spectrum, const double * const noise,
+							  const double * const alpha, const double * const beta, double * const gain, const unsigned int size)
+	{
+		const double * const bins = reinterpret_cast<const double *>(spectrum);
+		const float64x2_t dbl_min = vdupq_n_f64(real_min);
+
+		auto i = 0U;
+		for (; i + 2 <= size; i += 2)
+		{
+			const float64x2x2_t c = vld2q_f64(bins + 2 * i);
+			const float64x2_t power = vaddq_f64(vmulq_f64(c.val[0], c.val[0]), vmulq_f64(c.val[1], c.val[1]));
+
+			const float64x2_t a = vsubq_f64(power, vmulq_f64(vld1q_f64(alpha + i), vld1q_f64(noise + i)));
+			const float64x2_t b = vmulq_f64(vld1q_f64(beta + i), power);
+			vst1q_f64(gain + i, vsqrtq_f64(vdivq_f64(vmaxq_f64(a, b), vmaxq_f64(power, dbl_min))));
+		}
+
+		powerSubtractionScalar(spectrum + i, noise + i, alpha + i, beta + i, gain + i, size - i);
+	}
+
+	void geometricNEON(const std::complex<double> * const spectrum, const double * const noise,
+					   double * const prev_gamma, double * const prev_halfchi, double * const gain, const unsigned int size)
+	{
+		const double * const bins = reinterpret_cast<const double *>(spectrum);
+		const float64x2_t one = vdupq_n_f64(1.0);
+		const float64x2_t four = vdupq_n_f64(4.0);
+		const float64x2_t ga = vdupq_n_f64(geom_alpha), one_ga = vdupq_n_f64(1.0 - geom_alpha);
+		const float64x2_t gb = vdupq_n_f64(geom_beta), one_gb = vdupq_n_f64(1.0 - geom_beta);
+		const float64x2_t floor26 = vdupq_n_f64(twentysixdb);
+		const float64x2_t floor13 = vdupq_n_f64(thirteendb);
+
+		auto i = 0U;
+		for (; i + 2 <= size; i += 2)
+		{
+			const float64x2x2_t c = vld2q_f64(bins + 2 * i);
+			const float64x2_t power = vaddq_f64(vmulq_f64(c.val[0], c.val[0]), vmulq_f64(c.val[1], c.val[1]));
+			const float64x2_t n = vld1q_f64(noise + i);
+
+			// maxnm / minnm return the number when the other operand is NaN, like the scalar code
+			const float64x2_t gammai = vmaxnmq_f64(vdivq_f64(power, n), floor13);
+			const float64x2_t gamma = vaddq_f64(vmulq_f64(gb, vld1q_f64(prev_gamma + i)), vmulq_f64(one_gb, gammai));
+			vst1q_f64(prev_gamma + i, gamma);
+
+			const float64x2_t root = vsubq_f64(vsqrtq_f64(gamma), one);
+			const float64x2_t chi = vmaxnmq_f64(vaddq_f64(vmulq_f64(ga, vld1q_f64(prev_halfchi + i)),
+														  vmulq_f64(one_ga, vmulq_f64(root, root))), floor26);
+
+			const float64x2_t u = vaddq_f64(vsubq_f64(gamma, chi), one);
+			const float64x2_t v = vsubq_f64(vsubq_f64(gamma, one), chi);
+			const float64x2_t num = vsubq_f64(one, vdivq_f64(vmulq_f64(u, u), vmulq_f64(four, gamma)));
+			const float64x2_t den = vsubq_f64(one, vdivq_f64(vmulq_f64(v, v), vmulq_f64(four, chi)));
+			const float64x2_t h = vminnmq_f64(vsqrtq_f64(vdivq_f64(num, den)), one);
+
+			vst1q_f64(prev_halfchi + i, vdivq_f64(vmulq_f64(vmulq_f64(h, h), power), n));
+			vst1q_f64(gain + i, h);
+		}
+
+		geometricScalar(spectrum + i, noise + i, prev_gamma + i, prev_halfchi + i, gain + i, size - i);
+	}
+
+	void applyGainNEON(const std::complex<double> * const in, std::complex<double> * const out, double * const gain,
+					   const double * const prev_gain, const double floor, const double smoothing, const unsigned int size)
+	{
+		const double * const src = reinterpret_cast<const double *>(in);
+		double * const dst = reinterpret_cast<double *>(out);
+		const float64x2_t f = vdupq_n_f64(floor);
+		const float64x2_t s = vdupq_n_f64(smoothing), one_s = vdupq_n_f64(1.0 - smoothing);
+
+		auto i = 0U;
+		for (; i + 2 <= size; i += 2)
+		{
+			const float64x2_t g = vmaxnmq_f64(f, vaddq_f64(vmulq_f64(s, vld1q_f64(prev_gain + i)),
+														   vmulq_f64(one_s, vld1q_f64(gain + i))));
+			vst1q_f64(gain + i, g);
+
+			float64x2x2_t c = vld2q_f64(src + 2 * i);
+			c.val[0] = vmulq_f64(c.val[0], g);
+			c.val[1] = vmulq_f64(c.val[1], g);
+			vst2q_f64(dst + 2 * i, c);
+		}
+
+		applyGainScalar(in + i, out + i, gain + i, prev_gain + i, floor, smoothing, size - i);
+	}
+
+	void columnMinimumNEON(const double * const rows, const unsigned int nrows, double * const out, const unsigned int size)
+	{
+		auto i = 0U;
+		for (; i + 2 <= size; i += 2)
+		{
+			float64x2_t m = vld1q_f64(rows + i);
+			for (auto j = 1U; j < nrows; ++j)
+				m = vminq_f64(m, vld1q_f64(rows + j * size + i));
+			vst1q_f64(out + i, m);
+		}
+
+		for (; i < size; ++i)
+		{
+			double m = rows[i];
+			for (auto j = 1U; j < nrows; ++j)
+				m = std::min(m, rows[j * size + i]);
+			out[i] = m;
+		}
+	}
+
+	void shortToRealNEON(const short * const in, double * const out, const unsigned int size)
+	{
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			const int32x4_t x = vmovl_s16(vld1_s16(in + i));
+			vst1q_f64(out + i,     vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(x))), 1 / pcm_scale));
+			vst1q_f64(out + i + 2, vmulq_n_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(x))), 1 / pcm_scale));
+		}
+
+		shortToRealScalar(in + i, out + i, size - i);
+	}
+
+	void realToShortNEON(const double * const in, short * const out, const double scale, const unsigned int size)
+	{
+		const double factor = scale * pcm_scale;
+
+		auto i = 0U;
+		for (; i + 4 <= size; i += 4)
+		{
+			// The conversions truncate and saturate, the narrowings saturate again down to 16 bits
+			const int32x2_t a = vqmovn_s64(vcvtq_s64_f64(vmulq_n_f64(vld1q_f64(in + i), factor)));
+			const int32x2_t b = vqmovn_s64(vcvtq_s64_f64(vmulq_n_f64(vld1q_f64(in + i + 2), factor)));
+			vst1_s16(out + i, vqmovn_s32(vcombine_s32(a, b)));
+		}
+
+		realToShortScalar(in + i, out + i, scale, size - i);
+	}
+#endif
+#endif
+
+	//*** Runtime dispatch ***//
+	struct Kernels
+	{
+		decltype(&powerSubtractionScalar) powerSubtraction;
+		decltype(&geometricScalar) geometric;
+		decltype(&applyGainScalar) applyGain;
+		decltype(&columnMinimumScalar) columnMinimum;
+		decltype(&shortToRealScalar) shortToReal;
+		decltype(&realToShortScalar) realToShort;
+		const char* name;
+	};
+
+	Kernels selectKernels()
+	{
+#ifdef KERNELS_AVX2
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return Kernels{powerSubtractionAVX2, geometricAVX2, applyGainAVX2, columnMinimumAVX2, shortToRealAVX2, realToShortAVX2, "avx2"};
+#endif
+#ifdef KERNELS_NEON
+		return Kernels{powerSubtractionNEON, geometricNEON, applyGainNEON, columnMinimumNEON, shortToRealNEON, realToShortNEON, "neon"};
+#endif
+		return Kernels{powerSubtractionScalar, geometricScalar, applyGainScalar, columnMinimumScalar, shortToRealScalar, realToShortScalar, "scalar"};
+	}
+
+	const Kernels& kernels()
+	{
+		static const Kernels k = selectKernels();
+		return k;
+	}
+}
+
+namespace MathUtil
+{
+	void powerSubtractionGain(const std::complex<Real> * const spectrum, const Real * const noise,
+							  const Real * const alpha, const Real * const beta, Real * const gain, const unsigned int size)
+	{
+		kernels().powerSubtraction(spectrum, noise, alpha, beta, gain, size);
+	}
+
+	void geometricGain(const std::complex<Real> * const spectrum, const Real * const noise,
+					   Real * const prev_gamma, Real * const prev_halfchi, Real * const gain, const unsigned int size)
+	{
+		kernels().geometric(spectrum, noise, prev_gamma, prev_halfchi, gain, size);
+	}
+
+	void applyGain(const std::complex<Real> * const in, std::complex<Real> * const out, Real * const gain,
+				   const Real * const prev_gain, const Real floor, const Real smoothing, const unsigned int size)
+	{
+		kernels().applyGain(in, out, gain, prev_gain, floor, smoothing, size);
+	}
+
+	void columnMinimum(const Real * const rows, const unsigned int nrows, Real * const out, const unsigned int size)
+	{
+		kernels().columnMinimum(rows, nrows, out, size);
+	}
+
+	void shortToReal(const short * const in, Real * const out, const unsigned int size)
+	{
+		kernels().shortToReal(in, out, size);
+	}
+
+	void realToShort(const Real * const in, short * const out, const Real scale, const unsigned int size)
+	{
+		kernels().realToShort(in, out, scale, size);
+	}
+
+	const char* kernelInstructionSet()
+	{
+		return kernels().name;
+	}
+}
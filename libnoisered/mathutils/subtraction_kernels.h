@@ -0,0 +1,98 @@
+#pragma once
+#include <complex>
+#include "real.h"
+
+//! Mathematic utilities.
+namespace MathUtil
+{
+	/**
+	 * @brief Gain of the power spectral subtraction.
+	 *
+	 * For each bin, computes the real gain sqrt(max(P - alpha * N, beta * P) / P)
+	 * where P is the power of the bin and N the noise power.
+	 *
+	 * @param spectrum Spectrum of the frame.
+	 * @param noise Noise power.
+	 * @param alpha Over-subtraction factor, per bin.
+	 * @param beta Spectral floor, per bin.
+	 * @param gain Output gain.
+	 * @param size Number of bins.
+	 */
+	void powerSubtractionGain(const std::complex<Real> * const spectrum, const Real * const noise,
+							  const Real * const alpha, const Real * const beta, Real * const gain, const unsigned int size);
+
+	/**
+	 * @brief Gain of the geometric approach spectral subtraction.
+	 *
+	 * Cf. Lu & Loizou, "A geometric approach to spectral subtraction", 2008.
+	 *
+	 * @param spectrum Spectrum of the frame.
+	 * @param noise Noise power.
+	 * @param prev_gamma Smoothed a posteriori SNR of the previous frame. Updated.
+	 * @param prev_halfchi A priori SNR of the previous frame. Updated.
+	 * @param gain Output gain.
+	 * @param size Number of bins.
+	 */
+	void geometricGain(const std::complex<Real> * const spectrum, const Real * const noise,
+					   Real * const prev_gamma, Real * const prev_halfchi, Real * const gain, const unsigned int size);
+
+	/**
+	 * @brief Post-processes a gain and applies it to a spectrum, in a single pass.
+	 *
+	 * gain = max(floor, smoothing * prev_gain + (1 - smoothing) * gain), then out = in * gain.
+	 * The phase is kept without any trigonometric call. in and out may be the same array,
+	 * as well as gain and prev_gain when smoothing is 0.
+	 *
+	 * @param in Spectrum to modify.
+	 * @param out Output spectrum.
+	 * @param gain Gain of each bin. Receives the post-processed gain.
+	 * @param prev_gain Post-processed gain of the previous frame.
+	 * @param floor Minimum gain.
+	 * @param smoothing Weight of the previous gain, between 0 and 1.
+	 * @param size Number of bins.
+	 */
+	void applyGain(const std::complex<Real> * const in, std::complex<Real> * const out, Real * const gain,
+				   const Real * const prev_gain, const Real floor, const Real smoothing, const unsigned int size);
+
+	/**
+	 * @brief Minimum of each column of a row-major matrix.
+	 *
+	 * out[i] = min(rows[i], rows[size + i], ..., rows[(nrows - 1) * size + i]).
+	 *
+	 * @param rows Contiguous matrix of nrows rows of size values.
+	 * @param nrows Number of rows, at least 1.
+	 * @param out Output, size values.
+	 * @param size Number of columns.
+	 */
+	void columnMinimum(const Real * const rows, const unsigned int nrows, Real * const out, const unsigned int size);
+
+	/**
+	 * @brief Converts signed 16 bit PCM samples to the -1 / 1 range.
+	 *
+	 * @param in PCM samples.
+	 * @param out Output samples.
+	 * @param size Number of samples.
+	 */
+	void shortToReal(const short * const in, Real * const out, const unsigned int size);
+
+	/**
+	 * @brief Scales samples and converts them to signed 16 bit PCM, with saturation.
+	 *
+	 * out = in * scale * 32768, clamped to the range of a short and truncated toward zero,
+	 * like DoubleToShort. Scaling in the same pass avoids a separate normalization of
+	 * the inverse FFT output.
+	 *
+	 * @param in Samples, nominally in the -1 / 1 range once scaled.
+	 * @param out PCM output.
+	 * @param scale Factor applied before the conversion.
+	 * @param size Number of samples.
+	 */
+	void realToShort(const Real * const in, short * const out, const Real scale, const unsigned int size);
+
+	/**
+	 * @brief Name of the instruction set chosen at runtime for the kernels.
+	 *
+	 * @return const char* "avx2", "neon" or "scalar".
+	 */
+	const char* kernelInstructionSet();
+}
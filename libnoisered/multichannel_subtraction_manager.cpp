@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <functional>
+
+#include "multichannel_subtraction_manager.h"
+#include "mathutils/math_util.h"
+#include "mathutils/subtraction_kernels.h"
+
+MultiChannelSubtractionManager::MultiChannelSubtractionManager(const unsigned int channels, const unsigned int fft_Size, const unsigned int sampling_Rate):
+	_conf(fft_Size, sampling_Rate),
+	_channels(std::max(channels, 1U)),
+	_fft()
+{
+}
+
+SubtractionManager &MultiChannelSubtractionManager::configuration()
+{
+	return _conf;
+}
+
+unsigned int MultiChannelSubtractionManager::channels() const
+{
+	return _channels;
+}
+
+void MultiChannelSubtractionManager::setEstimationImplementation(Estimation *value)
+{
+	// The configuration keeps the original, for the algorithms which look it up
+	_conf.setEstimationImplementation(value);
+	_algorithmsChanged = true;
+}
+
+void MultiChannelSubtractionManager::setSubtractionImplementation(Subtraction *value)
+{
+	_conf.setSubtractionImplementation(value);
+	_algorithmsChanged = true;
+}
+
+unsigned int MultiChannelSubtractionManager::readBuffer(const short *buffer, const unsigned int length)
+{
+	_tabLength = length;
+	_data.resize(_channels * _tabLength);
+
+	// Deinterleaving: each row is then read and written contiguously by the frame loop
+	for (auto c = 0U; c < _channels; ++c)
+	{
+		Real * const row = _data.data() + c * _tabLength;
+		for (auto i = 0U; i < _tabLength; ++i)
+			row[i] = MathUtil::ShortToDouble(buffer[i * _channels + c]);
+	}
+
+	return _tabLength;
+}
+
+void MultiChannelSubtractionManager::writeBuffer(short * const buffer) const
+{
+	for (auto c = 0U; c < _channels; ++c)
+	{
+		const Real * const row = _data.data() + c * _tabLength;
+		for (auto i = 0U; i < _tabLength; ++i)
+			buffer[i * _channels + c] = MathUtil::DoubleToShort(row[i]);
+	}
+}
+
+Real *MultiChannelSubtractionManager::getData(const unsigned int channel)
+{
+	return _data.data() + channel * _tabLength;
+}
+
+unsigned int MultiChannelSubtractionManager::getLength() const
+{
+	return _tabLength;
+}
+
+void MultiChannelSubtractionManager::onDataUpdate()
+{
+	prepare();
+	std::fill(_prevGain.begin(), _prevGain.end(), 1);
+	for (const auto& estimation : _estimation)
+		estimation->onDataUpdate();
+	for (const auto& subtraction : _subtraction)
+		subtraction->onDataUpdate();
+}
+
+void MultiChannelSubtractionManager::prepare()
+{
+	const unsigned int size = _conf.FFTSize();
+	if (_fft.size() != size || _fft.count() != _channels)
+	{
+		_fft.updateSize(size, _channels);
+		_algorithmsChanged = true;
+	}
+	const unsigned int iterations = _conf.frameIterations();
+	if (!_algorithmsChanged && _preparedRate == _conf.getSamplingRate() && _preparedIterations == iterations)
+		return;
+
+	// The originals follow the size and rate of the configuration: copy them again
+	_estimation.clear();
+	_subtraction.clear();
+	for (auto i = 0U; i < _channels * iterations; ++i)
+	{
+		_estimation.emplace_back(_conf.getEstimationImplementation()->clone());
+		_subtraction.emplace_back(_conf.getSubtractionImplementation()->clone());
+	}
+	_gain.assign(_fft.spectrumSize(), 0);
+	_prevGain.assign(_channels * iterations * _fft.spectrumSize(), 1);
+	_frameAcc.assign(_channels * size, 0);
+
+	_algorithmsChanged = false;
+	_preparedRate = _conf.getSamplingRate();
+	_preparedIterations = iterations;
+}
+
+void MultiChannelSubtractionManager::execute()
+{
+	if (_conf.bypass()) return;
+	prepare();
+
+	const unsigned int spectrum_size = _fft.spectrumSize();
+	const unsigned int iterations = _conf.frameIterations();
+	const unsigned int hop = _conf.getFrameIncrement();
+	const unsigned int lead = _conf.frameLead();
+	const bool frame_output = _estimation.front()->usesFrameOutput();
+
+	// Like a file in SubtractionManager, each pass starts from the initial state
+	for (auto iter = 0U; iter < _conf.passes(); ++iter)
+	{
+		onDataUpdate();
+		std::fill(_frameAcc.begin(), _frameAcc.end(), 0);
+		_frameHead = 0;
+
+		// With WOLA, the first frames start before the signal
+		for (auto sample_n = 0U; sample_n < _tabLength + lead; sample_n += hop)
+		{
+			copyInput(sample_n);
+			_fft.forward();
+			for (auto c = 0U; c < _channels; ++c)
+				processSpectrum(c);
+			_fft.backward();
+
+			// The output is the one of the last iteration, when they are fused
+			if (frame_output)
+			{
+				for (auto c = 0U; c < _channels; ++c)
+					for (auto k = 0U; k < iterations; ++k)
+						_estimation[c * iterations + k]->onFrameOutput(_prevGain.data() + (c * iterations + k) * spectrum_size, _fft.output(c));
+			}
+			copyOutput(sample_n);
+		}
+	}
+}
+
+void MultiChannelSubtractionManager::processSpectrum(const unsigned int channel)
+{
+	const unsigned int spectrum_size = _fft.spectrumSize();
+	const unsigned int iterations = _conf.frameIterations();
+	const Real floor = (Real) _conf.gainFloor();
+	const Real smoothing = (Real) _conf.gainSmoothing();
+	std::complex<Real> * const spectrum = _fft.spectrum(channel);
+	Real * const gain = _gain.data();
+
+	for (auto k = 0U; k < iterations; ++k)
+	{
+		const unsigned int i = channel * iterations + k;
+		Real * const prev_gain = _prevGain.data() + i * spectrum_size;
+
+		(*_estimation[i])(spectrum);
+		_subtraction[i]->computeGain(spectrum, _estimation[i]->noisePower(), gain);
+		MathUtil::applyGain(spectrum, spectrum, gain, prev_gain, floor, smoothing, spectrum_size);
+		std::copy_n(gain, spectrum_size, prev_gain);
+	}
+}
+
+void MultiChannelSubtractionManager::copyInput(const unsigned int pos)
+{
+	// With OLA, the frame is the hop followed by zeros, and the output is added to the data.
+	// With WOLA, it starts lead samples before pos, with zeros before the signal, and is windowed.
+	const bool wola = _conf.WOLAenabled();
+	const bool ola = _conf.OLAenabled() && !wola;
+	const int start = (int) pos - (int) _conf.frameLead();
+	const unsigned int skip = start < 0 ? (unsigned int) -start : 0;
+	const int first = start + (int) skip;
+	const unsigned int frame_length = _conf.frameInputLength();
+	const unsigned int length = first < (int) _tabLength ? std::min(frame_length - skip, _tabLength - (unsigned int) first) : 0;
+	for (auto c = 0U; c < _channels; ++c)
+	{
+		Real * const row = _data.data() + c * _tabLength + first;
+		Real * const input = _fft.input(c);
+		std::fill_n(input, skip, 0);
+		std::copy_n(row, length, input + skip);
+		std::fill(input + skip + length, input + _fft.size(), 0);
+		if (ola)
+			std::fill_n(row, length, 0);
+		if (wola)
+			std::transform(input, input + _fft.size(), _conf._analysisWindow->begin(), input, std::multiplies<Real>());
+	}
+}
+
+void MultiChannelSubtractionManager::copyOutput(const unsigned int pos)
+{
+	const unsigned int size = _fft.size();
+	if (_conf.WOLAenabled())
+	{
+		// The completed hop starts where the frame does, maybe before the signal
+		const unsigned int hop = _conf.getFrameIncrement();
+		const Real * const window = _conf._synthesisWindow->data();
+		const int start = (int) pos - (int) _conf.frameLead();
+		const unsigned int skip = start < 0 ? (unsigned int) -start : 0;
+		const bool in_signal = skip < hop && start + (int) skip < (int) _tabLength;
+		const unsigned int wrap = size - _frameHead;
+		for (auto c = 0U; c < _channels; ++c)
+		{
+			Real * const acc = _frameAcc.data() + c * size;
+			const Real * const output = _fft.output(c);
+			for (auto j = 0U; j < wrap; ++j)
+				acc[_frameHead + j] += output[j] * window[j];
+			for (auto j = wrap; j < size; ++j)
+				acc[j - wrap] += output[j] * window[j];
+
+			Real * const done = acc + _frameHead;
+			if (in_signal)
+			{
+				const unsigned int first = (unsigned int) start + skip;
+				std::copy_n(done + skip, std::min(hop - skip, _tabLength - first), _data.data() + c * _tabLength + first);
+			}
+			std::fill_n(done, hop, 0);
+		}
+		_frameHead = (_frameHead + hop) % size;
+		return;
+	}
+
+	const Real norm = _fft.normalizationFactor();
+	const unsigned int length = std::min(size, _tabLength - pos);
+	for (auto c = 0U; c < _channels; ++c)
+	{
+		Real * const row = _data.data() + c * _tabLength + pos;
+		const Real * const output = _fft.output(c);
+		if (_conf.OLAenabled())
+		{
+			for (auto j = 0U; j < length; ++j)
+				row[j] += output[j] * norm;
+		}
+		else
+		{
+			std::transform(output, output + length, row, [norm] (Real x) { return x * norm; });
+		}
+	}
+}
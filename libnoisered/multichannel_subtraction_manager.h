@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+
+#include "subtraction_manager.h"
+#include "fft/fftwbatchmanager.h"
+
+/**
+ * @brief Processes several channels (e.g. of a microphone array) with a single frame loop.
+ *
+ * The interleaved input is split into one buffer per channel. For each frame, the
+ * forward and backward FFTs of all the channels are computed by one batched FFTW call,
+ * then each channel goes through its own copy of the estimation and subtraction algorithms.
+ * The gains are kept in planar arrays, one spectrum-sized row per channel.
+ *
+ * The parameters (FFT size, sampling rate, iterations, fused or not, OLA or WOLA, gain floor
+ * and smoothing) are those of configuration(), which is also the manager given to the algorithms.
+ * Each channel gives the same output as SubtractionManager with a file: the algorithms
+ * restart from their initial state at each pass over the buffer.
+ * Threads and streaming are only available in SubtractionManager.
+ */
+class MultiChannelSubtractionManager
+{
+	public:
+		/**
+		 * @brief Constructor
+		 *
+		 * @param channels Number of interleaved channels.
+		 * @param fft_Size Wanted size of FFT. Must be a power of two.
+		 * @param sampling_Rate Sampling rate of the audio.
+		 */
+		MultiChannelSubtractionManager(const unsigned int channels, const unsigned int fft_Size, const unsigned int sampling_Rate);
+
+		MultiChannelSubtractionManager(const MultiChannelSubtractionManager&) = delete;
+		MultiChannelSubtractionManager& operator=(const MultiChannelSubtractionManager&) = delete;
+
+		/**
+		 * @brief Parameters shared by all the channels.
+		 *
+		 * The algorithms must be constructed with it, e.g. new SimpleEstimation(mgr.configuration()),
+		 * and set with setEstimationImplementation() / setSubtractionImplementation() below.
+		 *
+		 * @return SubtractionManager& Configuration.
+		 */
+		SubtractionManager& configuration();
+
+		/**
+		 * @brief Number of channels.
+		 *
+		 * @return unsigned int Channels.
+		 */
+		unsigned int channels() const;
+
+		/**
+		 * @brief Sets the estimation algorithm, copied for each channel.
+		 *
+		 * @param value Estimation to use.
+		 */
+		void setEstimationImplementation(Estimation * value);
+
+		/**
+		 * @brief Sets the subtraction algorithm, copied for each channel.
+		 *
+		 * @param value Subtraction to use.
+		 */
+		void setSubtractionImplementation(Subtraction * value);
+
+		/**
+		 * @brief Reads an interleaved buffer.
+		 *
+		 * @param buffer Short buffer, the channels of each sample follow each other.
+		 * @param length Number of samples per channel.
+		 * @return unsigned int Number of samples per channel.
+		 */
+		unsigned int readBuffer(const short * buffer, const unsigned int length);
+
+		/**
+		 * @brief Writes the processed channels, interleaved.
+		 *
+		 * @param buffer Buffer of length() * channels() samples.
+		 */
+		void writeBuffer(short * const buffer) const;
+
+		/**
+		 * @brief Returns the processed samples of a channel.
+		 *
+		 * @param channel Channel.
+		 * @return Real* length() samples.
+		 */
+		Real *getData(const unsigned int channel);
+
+		/**
+		 * @brief Number of samples per channel.
+		 *
+		 * @return unsigned int Length.
+		 */
+		unsigned int getLength() const;
+
+		/**
+		 * @brief Resets the state of the algorithms of every channel, e.g. for a new recording.
+		 */
+		void onDataUpdate();
+
+		/**
+		 * @brief execute Runs the algorithm on all the channels.
+		 */
+		void execute();
+
+	private:
+		/**
+		 * @brief Makes the plans, the copies of the algorithms and the gain arrays
+		 * when the FFT size, the sampling rate, the fused iterations or the algorithms changed.
+		 */
+		void prepare();
+
+		/**
+		 * @brief Runs the estimation and the subtraction of each iteration of the frame
+		 * of a channel, in place.
+		 *
+		 * @param channel Channel.
+		 */
+		void processSpectrum(const unsigned int channel);
+
+		/**
+		 * @brief Copies the frame starting at pos of each channel into the FFT inputs.
+		 *
+		 * @param pos Sample where the frame starts.
+		 */
+		void copyInput(const unsigned int pos);
+
+		/**
+		 * @brief Copies (or adds, with OLA) the FFT outputs into the channels.
+		 * With WOLA, overlap-adds them and writes the completed hop.
+		 *
+		 * @param pos Sample where the frame starts, after its lead with WOLA.
+		 */
+		void copyOutput(const unsigned int pos);
+
+		//*** Members ***//
+		SubtractionManager _conf;
+		unsigned int _channels = 0;
+
+		// Algorithms, one copy per channel and fused iteration, channel-major
+		std::vector<Estimation_p> _estimation = std::vector<Estimation_p>();
+		std::vector<Subtraction_p> _subtraction = std::vector<Subtraction_p>();
+		bool _algorithmsChanged = true;
+		unsigned int _preparedRate = 0; /**< Sampling rate of the copies */
+		unsigned int _preparedIterations = 0; /**< Iterations per frame of the copies */
+
+		// Planar storage, one row per channel
+		FFTWBatchManager _fft;
+		unsigned int _tabLength = 0;
+		std::vector<Real> _data = std::vector<Real>(); /**< Channels, length each */
+		std::vector<Real> _gain = std::vector<Real>(); /**< Gain of the current frame, spectrum size */
+		std::vector<Real> _prevGain = std::vector<Real>(); /**< Gain of the previous frame, spectrum size per channel and fused iteration */
+		std::vector<Real> _frameAcc = std::vector<Real>(); /**< WOLA accumulators, circular, FFT size per channel */
+		unsigned int _frameHead = 0; /**< Start of the accumulators */
+};
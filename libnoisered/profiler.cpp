@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+namespace
+{
+	typedef std::atomic<std::uint64_t> Counter;
+
+	//! Histograms of a thread. Only this thread writes them.
+	struct ThreadHistograms
+	{
+		Counter count[Profiler::stage_count];
+		Counter total[Profiler::stage_count];
+		Counter min[Profiler::stage_count];
+		Counter max[Profiler::stage_count];
+		Counter buckets[Profiler::stage_count][Profiler::bucket_count];
+	};
+
+	//! Adds to a counter of the calling thread: it is the only writer.
+	inline void add(Counter& counter, const std::uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	//! Number of significant bits.
+	inline unsigned int bitLength(const std::uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		return _BitScanReverse64(&index, value) ? (unsigned int) index + 1 : 0;
+#else
+		return value ? 64 - (unsigned int) __builtin_clzll(value) : 0;
+#endif
+	}
+
+	std::mutex& registryMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	//! Histograms of every thread which recorded something. Never shrinks.
+	std::vector<std::unique_ptr<ThreadHistograms>>& registry()
+	{
+		static std::vector<std::unique_ptr<ThreadHistograms>> histograms;
+		return histograms;
+	}
+
+	ThreadHistograms& threadHistograms()
+	{
+		// Registration locks once per thread
+		thread_local ThreadHistograms *histograms = nullptr;
+		if (!histograms)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex());
+			registry().emplace_back(new ThreadHistograms());
+			histograms = registry().back().get();
+		}
+		return *histograms;
+	}
+
+	void merge(Profiler::Statistics& stats, const ThreadHistograms& histograms, const unsigned int s)
+	{
+		const std::uint64_t count = histograms.count[s].load(std::memory_order_relaxed);
+		if (count == 0) return;
+
+		const std::uint64_t min = histograms.min[s].load(std::memory_order_relaxed);
+		stats.min = stats.count == 0 ? min : std::min(stats.min, min);
+		stats.max = std::max(stats.max, histograms.max[s].load(std::memory_order_relaxed));
+		stats.count += count;
+		stats.total += histograms.total[s].load(std::memory_order_relaxed);
+		for (auto b = 0U; b < Profiler::bucket_count; ++b)
+			stats.histogram[b] += histograms.buckets[s][b].load(std::memory_order_relaxed);
+	}
+
+	void writeCSVLine(std::ostream& out, const char *thread, const Profiler::Stage stage, const Profiler::Statistics& stats)
+	{
+		out << thread << ',' << Profiler::stageName(stage) << ',' << stats.count << ',' << stats.total << ','
+			<< stats.min << ',' << stats.max << ',' << stats.mean() << ','
+			<< stats.percentile(0.5) << ',' << stats.percentile(0.9) << ',' << stats.percentile(0.99) << '\n';
+	}
+}
+
+constexpr unsigned int Profiler::stage_count;
+constexpr unsigned int Profiler::bucket_count;
+
+double Profiler::Statistics::mean() const
+{
+	return count == 0 ? 0 : double(total) / double(count);
+}
+
+std::uint64_t Profiler::Statistics::percentile(const double fraction) const
+{
+	const double rank = fraction * double(count);
+	std::uint64_t seen = 0;
+	for (auto b = 0U; b < bucket_count; ++b)
+	{
+		seen += histogram[b];
+		if (histogram[b] > 0 && double(seen) >= rank)
+			return b == 0 ? 0 : std::min(max, (std::uint64_t(2) << (b - 1)) - 1);
+	}
+	return max;
+}
+
+bool Profiler::enabled()
+{
+#ifdef NOISERED_PROFILING
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char *Profiler::stageName(const Stage stage)
+{
+	static const char * const names[stage_count] =
+	{ "copyInput", "forwardFFT", "estimation", "subtraction", "backwardFFT", "frameOutput", "copyOutput" };
+	return names[(unsigned int) stage];
+}
+
+unsigned int Profiler::threads()
+{
+	std::lock_guard<std::mutex> lock(registryMutex());
+	return (unsigned int) registry().size();
+}
+
+Profiler::Statistics Profiler::statistics(const Stage stage)
+{
+	Statistics stats;
+	std::lock_guard<std::mutex> lock(registryMutex());
+	for (const auto& histograms : registry())
+		merge(stats, *histograms, (unsigned int) stage);
+	return stats;
+}
+
+Profiler::Statistics Profiler::statistics(const Stage stage, const unsigned int thread)
+{
+	Statistics stats;
+	std::lock_guard<std::mutex> lock(registryMutex());
+	if (thread < registry().size())
+		merge(stats, *registry()[thread], (unsigned int) stage);
+	return stats;
+}
+
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(registryMutex());
+	for (const auto& histograms : registry())
+	{
+		for (auto s = 0U; s < stage_count; ++s)
+		{
+			histograms->count[s].store(0, std::memory_order_relaxed);
+			histograms->total[s].store(0, std::memory_order_relaxed);
+			histograms->min[s].store(0, std::memory_order_relaxed);
+			histograms->max[s].store(0, std::memory_order_relaxed);
+			for (auto& bucket : histograms->buckets[s])
+				bucket.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+double Profiler::cyclesPerSecond()
+{
+	static const double frequency = []
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const std::uint64_t start_cycles = cycles();
+		auto now = start;
+		while (now - start < std::chrono::milliseconds(20))
+			now = std::chrono::steady_clock::now();
+		return double(cycles() - start_cycles) / std::chrono::duration<double>(now - start).count();
+	}();
+	return frequency;
+}
+
+void Profiler::dumpJSON(std::ostream &out)
+{
+	out << "{\n\t\"enabled\": " << (enabled() ? "true" : "false")
+		<< ",\n\t\"cycles_per_second\": " << cyclesPerSecond()
+		<< ",\n\t\"threads\": " << threads()
+		<< ",\n\t\"stages\": [";
+	for (auto s = 0U; s < stage_count; ++s)
+	{
+		const Stage stage = (Stage) s;
+		const Statistics stats = statistics(stage);
+		out << (s == 0 ? "\n" : ",\n")
+			<< "\t\t{\"stage\": \"" << stageName(stage) << "\", \"count\": " << stats.count
+			<< ", \"total_cycles\": " << stats.total << ", \"min_cycles\": " << stats.min
+			<< ", \"max_cycles\": " << stats.max << ", \"mean_cycles\": " << stats.mean()
+			<< ", \"p50_cycles\": " << stats.percentile(0.5) << ", \"p90_cycles\": " << stats.percentile(0.9)
+			<< ", \"p99_cycles\": " << stats.percentile(0.99) << ", \"histogram\": [";
+		for (auto b = 0U; b < bucket_count; ++b)
+			out << (b == 0 ? "" : ", ") << stats.histogram[b];
+		out << "]}";
+	}
+	out << "\n\t]\n}\n";
+}
+
+void Profiler::dumpCSV(std::ostream &out)
+{
+	out << "thread,stage,count,total_cycles,min_cycles,max_cycles,mean_cycles,p50_cycles,p90_cycles,p99_cycles\n";
+	for (auto s = 0U; s < stage_count; ++s)
+		writeCSVLine(out, "all", (Stage) s, statistics((Stage) s));
+
+	const unsigned int thread_count = threads();
+	for (auto t = 0U; t < thread_count; ++t)
+	{
+		const std::string thread = std::to_string(t);
+		for (auto s = 0U; s < stage_count; ++s)
+			writeCSVLine(out, thread.c_str(), (Stage) s, statistics((Stage) s, t));
+	}
+}
+
+void Profiler::record(const Stage stage, const std::uint64_t duration)
+{
+	ThreadHistograms& histograms = threadHistograms();
+	const auto s = (unsigned int) stage;
+
+	if (histograms.count[s].load(std::memory_order_relaxed) == 0 || duration < histograms.min[s].load(std::memory_order_relaxed))
+		histograms.min[s].store(duration, std::memory_order_relaxed);
+	if (duration > histograms.max[s].load(std::memory_order_relaxed))
+		histograms.max[s].store(duration, std::memory_order_relaxed);
+	add(histograms.count[s], 1);
+	add(histograms.total[s], duration);
+	add(histograms.buckets[s][std::min(bitLength(duration), bucket_count - 1)], 1);
+}
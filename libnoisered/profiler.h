@@ -0,0 +1,187 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Timings of the stages of the frame loop of SubtractionManager.
+ *
+ * When the library is built with NOISERED_PROFILING (CONFIG += profiling), each stage
+ * of a frame is timed with the cycle counter, and its duration is added to a histogram
+ * of the thread, in power-of-two buckets. Each thread only writes its own histograms,
+ * without lock nor atomic read-modify-write, and they can be read at any time.
+ *
+ * Without NOISERED_PROFILING, NOISERED_PROFILE() expands to nothing and the statistics are empty.
+ */
+class Profiler
+{
+	public:
+		//! Stages of a frame. FrameOutput is only timed for the estimations which use the output of the frames.
+		enum class Stage : unsigned int { CopyInput, ForwardFFT, Estimation, Subtraction, BackwardFFT, FrameOutput, CopyOutput };
+
+		//! Number of stages.
+		static constexpr unsigned int stage_count = 7;
+
+		//! Number of buckets: the bucket k holds the durations of k significant bits, 2^(k-1) to 2^k - 1 cycles.
+		static constexpr unsigned int bucket_count = 64;
+
+		/**
+		 * @brief Durations of a stage, in cycles.
+		 */
+		struct Statistics
+		{
+			std::uint64_t count = 0; /**< Number of measures */
+			std::uint64_t total = 0; /**< Sum of the durations */
+			std::uint64_t min = 0; /**< Shortest duration */
+			std::uint64_t max = 0; /**< Longest duration */
+			std::array<std::uint64_t, bucket_count> histogram = std::array<std::uint64_t, bucket_count>(); /**< Measures per bucket */
+
+			/**
+			 * @brief Mean duration.
+			 *
+			 * @return double Cycles, 0 without measure.
+			 */
+			double mean() const;
+
+			/**
+			 * @brief Approximate percentile: upper limit of the bucket where it falls.
+			 *
+			 * @param fraction Between 0 and 1, e.g. 0.99.
+			 * @return std::uint64_t Cycles, at most max.
+			 */
+			std::uint64_t percentile(const double fraction) const;
+		};
+
+		/**
+		 * @brief Measures the time spent in a scope.
+		 */
+		class Scope
+		{
+			public:
+				explicit Scope(const Stage stage):
+					_stage(stage),
+					_start(cycles())
+				{
+				}
+
+				~Scope()
+				{
+					record(_stage, cycles() - _start);
+				}
+
+				Scope(const Scope&) = delete;
+				Scope& operator=(const Scope&) = delete;
+
+			private:
+				const Stage _stage;
+				const std::uint64_t _start;
+		};
+
+		/**
+		 * @brief Tells if the library records the timings.
+		 *
+		 * @return bool true if it was built with NOISERED_PROFILING.
+		 */
+		static bool enabled();
+
+		/**
+		 * @brief Name of a stage, as in the dumps.
+		 *
+		 * @param stage Stage.
+		 * @return const char* e.g. "forwardFFT".
+		 */
+		static const char *stageName(const Stage stage);
+
+		/**
+		 * @brief Number of threads which recorded timings.
+		 *
+		 * @return unsigned int Threads.
+		 */
+		static unsigned int threads();
+
+		/**
+		 * @brief Durations of a stage, on all the threads.
+		 *
+		 * @param stage Stage.
+		 * @return Statistics Statistics.
+		 */
+		static Statistics statistics(const Stage stage);
+
+		/**
+		 * @brief Durations of a stage, on one thread.
+		 *
+		 * @param stage Stage.
+		 * @param thread Thread, in the order of their first measure, below threads().
+		 * @return Statistics Statistics.
+		 */
+		static Statistics statistics(const Stage stage, const unsigned int thread);
+
+		/**
+		 * @brief Clears the histograms.
+		 *
+		 * Measures recorded during the call may be partly kept.
+		 */
+		static void reset();
+
+		/**
+		 * @brief Frequency of the cycle counter, measured at the first call (about 20 ms).
+		 *
+		 * @return double Cycles per second.
+		 */
+		static double cyclesPerSecond();
+
+		/**
+		 * @brief Writes the statistics of all the threads, with the histograms, as a JSON object.
+		 *
+		 * @param out Stream.
+		 */
+		static void dumpJSON(std::ostream& out);
+
+		/**
+		 * @brief Writes the statistics as CSV, one line per stage for all the threads ("all")
+		 * then for each thread.
+		 *
+		 * @param out Stream.
+		 */
+		static void dumpCSV(std::ostream& out);
+
+		/**
+		 * @brief Adds a duration to the histogram of the calling thread.
+		 *
+		 * @param stage Stage.
+		 * @param duration Cycles.
+		 */
+		static void record(const Stage stage, const std::uint64_t duration);
+
+		/**
+		 * @brief Cycle counter: TSC on x86, virtual counter on ARM64, else steady clock.
+		 *
+		 * @return std::uint64_t Cycles.
+		 */
+		static std::uint64_t cycles()
+		{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#elif defined(__aarch64__)
+			std::uint64_t value;
+			asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+			return value;
+#else
+			return (std::uint64_t) std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+		}
+};
+
+#ifdef NOISERED_PROFILING
+//! Times the rest of the scope as the stage Profiler::Stage::stage.
+#define NOISERED_PROFILE(stage) Profiler::Scope noisered_profile_scope(Profiler::Stage::stage)
+#else
+#define NOISERED_PROFILE(stage)
+#endif
@@ -1,10 +1,8 @@
 #include <cmath>
-#include <fstream>
-#include <clocale>
 
 #include "el_ss.h"
+#include "loudness_contour.h"
 #include "mathutils/math_util.h"
-#include "mathutils/spline.hpp"
 #include "subtraction_manager.h"
 
 EqualLoudnessSpectralSubtraction::EqualLoudnessSpectralSubtraction(const SubtractionManager &configuration):
@@ -14,11 +12,10 @@ EqualLoudnessSpectralSubtraction::EqualLoudnessSpectralSubtraction(const Subtrac
 
 EqualLoudnessSpectralSubtraction::EqualLoudnessSpectralSubtraction(const EqualLoudnessSpectralSubtraction &el):
 	SimpleSpectralSubtraction(el),
+	_loudnessContour(el._loudnessContour),
 	_alphawt(el.alphawt()),
 	_betawt(el.betawt())
 {
-	loudness_contour = new double[conf.spectrumSize()];
-	std::copy_n(el.loudness_contour, conf.spectrumSize(), loudness_contour);
 }
 
 Subtraction *EqualLoudnessSpectralSubtraction::clone()
@@ -28,78 +25,51 @@ Subtraction *EqualLoudnessSpectralSubtraction::clone()
 
 const EqualLoudnessSpectralSubtraction& EqualLoudnessSpectralSubtraction::operator=(const EqualLoudnessSpectralSubtraction &el)
 {
+	_loudnessContour = el._loudnessContour;
 	setAlpha(el.alpha());
 	setBeta(el.beta());
 	setAlphawt(el.alphawt());
 	setBetawt(el.betawt());
 
-	delete[] loudness_contour;
-	loudness_contour = new double[conf.spectrumSize()];
-	std::copy_n(el.loudness_contour, conf.spectrumSize(), loudness_contour);
-
 	return *this;
 }
 
 
-void EqualLoudnessSpectralSubtraction::operator()(std::complex<double>* const input_spectrum, const double * const noise_spectrum)
+void EqualLoudnessSpectralSubtraction::onFFTSizeUpdate()
 {
-	#pragma omp parallel for
-	for (auto i = 0U; i < conf.spectrumSize(); ++i)
-	{
-		double Apower, Bpower, magnitude, phase, power, alpha_tmp, beta_tmp;
-		alpha_tmp = _alpha - _alphawt * (loudness_contour[i] - 60);
-		beta_tmp  = _beta  - _betawt  * (loudness_contour[i] - 60);
-
-		power = std::norm(input_spectrum[i]);
-		phase = std::arg(input_spectrum[i]);
-
-		Apower = power - alpha_tmp * noise_spectrum[i];
-		Bpower = beta_tmp * power;
-
-		magnitude = std::sqrt(std::max(Apower, Bpower));
-
-		input_spectrum[i] = {magnitude * std::cos(phase), magnitude * std::sin(phase)};
-	}
+	loadLoudnessContour();
+	updateBinParameters();
 }
 
-void EqualLoudnessSpectralSubtraction::onFFTSizeUpdate()
+void EqualLoudnessSpectralSubtraction::updateBinParameters()
 {
-	loadLoudnessContour();
+	// The contour is only known once the FFT size is set
+	if (!_loudnessContour)
+	{
+		SimpleSpectralSubtraction::updateBinParameters();
+		return;
+	}
+
+	const std::vector<double>& contour = *_loudnessContour;
+	std::vector<Real> alpha_bins(conf.spectrumSize());
+	std::vector<Real> beta_bins(conf.spectrumSize());
+	for (auto i = 0U; i < conf.spectrumSize(); ++i)
+	{
+		alpha_bins[i] = (Real) (_alpha - _alphawt * (contour[i] - 60));
+		beta_bins[i]  = (Real) (_beta  - _betawt  * (contour[i] - 60));
+	}
+	_alphaBins = std::make_shared<const std::vector<Real>>(std::move(alpha_bins));
+	_betaBins = std::make_shared<const std::vector<Real>>(std::move(beta_bins));
 }
 
 EqualLoudnessSpectralSubtraction::~EqualLoudnessSpectralSubtraction()
 {
-	delete[] loudness_contour;
 }
 
 void EqualLoudnessSpectralSubtraction::loadLoudnessContour()
 {
-	// loading data for loudness contour algo
-#ifdef __linux__
-	setlocale(LC_ALL, "POSIX");
-	// Because on french OS linux will try to read numbers with commas instead of dots
-#endif
-
-	MathUtil::Spline spline;
-
-	std::ifstream ldata("60phon/loudness_real.data");
-
-	double freq, val;
-	while(ldata >> freq >> val)
-	{
-		spline.addPoint(freq, val);
-	}
-	ldata.close();
-
-	delete[] loudness_contour;
-	loudness_contour = new double[conf.spectrumSize()];
-
-	const double freq_bin_span = double(conf.getSamplingRate()) / conf.FFTSize();
-
-	for(auto i = 0U; i < conf.spectrumSize(); ++i)
-	{
-		loudness_contour[i] = spline(i * freq_bin_span);
-	}
+	// Computed once per sampling rate and FFT size, for all the instances
+	_loudnessContour = LoudnessContour::bins(conf.getSamplingRate(), conf.FFTSize());
 }
 
 void EqualLoudnessSpectralSubtraction::onDataUpdate()
@@ -116,6 +86,7 @@ double EqualLoudnessSpectralSubtraction::alphawt() const
 void EqualLoudnessSpectralSubtraction::setAlphawt(const double value)
 {
 	_alphawt = std::max(value, 0.0);
+	updateBinParameters();
 }
 double EqualLoudnessSpectralSubtraction::betawt() const
 {
@@ -125,4 +96,5 @@ double EqualLoudnessSpectralSubtraction::betawt() const
 void EqualLoudnessSpectralSubtraction::setBetawt(const double value)
 {
 	_betawt = std::max(value, 0.0);
+	updateBinParameters();
 }
@@ -15,7 +15,6 @@ class EqualLoudnessSpectralSubtraction : public SimpleSpectralSubtraction
 		~EqualLoudnessSpectralSubtraction();
 		virtual Subtraction* clone() override;
 
-		virtual void operator()(std::complex<double>* const input_spectrum, const double * const noise_spectrum) override;
 		virtual void onFFTSizeUpdate() override;
 		virtual void onDataUpdate() override;
 
@@ -50,14 +49,18 @@ class EqualLoudnessSpectralSubtraction : public SimpleSpectralSubtraction
 		void setBetawt(const double value);
 
 
+	protected:
+		/**
+		 * @brief Weights alpha and beta of each bin by the loudness contour.
+		 */
+		virtual void updateBinParameters() override;
+
 	private:
 		/**
-		 * @brief Loads loudness contour data and interpolates it.
-		 *
-		 * @param config Configuration.
+		 * @brief Gets the loudness contour of the sampling rate and FFT size.
 		 */
 		void loadLoudnessContour();
-		double *loudness_contour = nullptr; /**< TODO */
+		std::shared_ptr<const std::vector<double>> _loudnessContour = nullptr; /**< Loudness of each bin, shared by the clones */
 
 		double _alphawt = 0; /**< TODO */
 		double _betawt = 0; /**< TODO */
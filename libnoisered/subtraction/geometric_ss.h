@@ -15,12 +15,12 @@ class GeometricSpectralSubtraction : public Subtraction
 
 		virtual ~GeometricSpectralSubtraction();
 
-		virtual void operator()(std::complex<double>* const input_spectrum, const double* const noise_spectrum) override;
+		virtual void computeGain(const std::complex<Real>* const input_spectrum, const Real* const noise_spectrum, Real* const gain) override;
 
 		virtual void onFFTSizeUpdate() override;
 		virtual void onDataUpdate() override;
 
 	private:
-		double *prev_gamma = nullptr; /**< TODO */
-		double *prev_halfchi = nullptr; /**< TODO */
+		Real *prev_gamma = nullptr; /**< TODO */
+		Real *prev_halfchi = nullptr; /**< TODO */
 };
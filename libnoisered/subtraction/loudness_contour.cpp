@@ -0,0 +1,68 @@
+#include <clocale>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#include "loudness_contour.h"
+#include "mathutils/spline.hpp"
+
+namespace
+{
+	//! Reference points of 60phon/loudness_real.data: frequency (Hz), loudness (dB).
+	constexpr double builtin_points[][2]
+	{
+		{20.0, 109.5}, {25.0, 104.2}, {31.5, 99.1}, {40.0, 94.2}, {50.0, 90.0},
+		{63.0, 85.9}, {80.0, 82.1}, {100.0, 78.7}, {125.0, 75.6}, {160.0, 72.5},
+		{200.0, 69.9}, {250.0, 67.5}, {315.0, 65.4}, {400.0, 63.5}, {500.0, 62.1},
+		{630.0, 60.8}, {800.0, 59.9}, {1000.0, 60.0}, {1250.0, 62.2}, {1600.0, 63.2},
+		{2000.0, 60.0}, {2500.0, 57.3}, {3150.0, 56.4}, {4000.0, 57.6}, {5000.0, 60.9},
+		{6300.0, 66.4}, {8000.0, 71.7}, {10000.0, 73.2}, {12500.0, 68.6}
+	};
+
+	void addReferencePoints(MathUtil::Spline& spline)
+	{
+#ifndef NOISERED_BUILTIN_LOUDNESS
+#ifdef __linux__
+		setlocale(LC_ALL, "POSIX");
+		// Because on french OS linux will try to read numbers with commas instead of dots
+#endif
+
+		std::ifstream ldata("60phon/loudness_real.data");
+
+		double freq, val;
+		while(ldata >> freq >> val)
+		{
+			spline.addPoint(freq, val);
+		}
+		if (!spline.empty()) return;
+#endif
+
+		for (const auto& point : builtin_points)
+			spline.addPoint(point[0], point[1]);
+	}
+}
+
+std::shared_ptr<const std::vector<double>> LoudnessContour::bins(const unsigned int sampling_rate, const unsigned int fft_size)
+{
+	static std::mutex mutex;
+	static MathUtil::Spline spline;
+	static std::map<std::pair<unsigned int, unsigned int>, std::shared_ptr<const std::vector<double>>> cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& table = cache[std::make_pair(sampling_rate, fft_size)];
+	if (table) return table;
+
+	if (spline.empty())
+		addReferencePoints(spline);
+
+	std::vector<double> contour(fft_size / 2 + 1);
+	const double freq_bin_span = double(sampling_rate) / fft_size;
+	for(auto i = 0U; i < contour.size(); ++i)
+	{
+		contour[i] = i * freq_bin_span;
+	}
+	spline.evaluate(contour.data(), contour.data(), contour.size());
+
+	table = std::make_shared<const std::vector<double>>(std::move(contour));
+	return table;
+}
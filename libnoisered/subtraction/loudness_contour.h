@@ -0,0 +1,29 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 60 phon equal-loudness contour, sampled at the bins of a spectrum.
+ *
+ * The spline is fitted on the reference points once per process, and evaluated
+ * once per (sampling rate, FFT size): the tables are shared by every algorithm
+ * and never modified.
+ *
+ * The reference points are read from 60phon/loudness_real.data. When the library
+ * is built with NOISERED_BUILTIN_LOUDNESS (CONFIG += builtin_loudness), or when the
+ * file can not be read, the same points compiled in the library are used instead.
+ */
+class LoudnessContour
+{
+	public:
+		/**
+		 * @brief Returns the loudness of each bin.
+		 *
+		 * Thread-safe.
+		 *
+		 * @param sampling_rate Sampling rate.
+		 * @param fft_size FFT size.
+		 * @return Table of fft_size / 2 + 1 values, in dB.
+		 */
+		static std::shared_ptr<const std::vector<double>> bins(const unsigned int sampling_rate, const unsigned int fft_size);
+};
@@ -2,6 +2,7 @@
 
 #include "simple_ss.h"
 #include "mathutils/math_util.h"
+#include "mathutils/subtraction_kernels.h"
 #include "subtraction_manager.h"
 
 SimpleSpectralSubtraction::SimpleSpectralSubtraction(const SubtractionManager& configuration):
@@ -19,28 +20,20 @@ Subtraction *SimpleSpectralSubtraction::clone()
 	return new SimpleSpectralSubtraction(*this);
 }
 
-void SimpleSpectralSubtraction::operator()(std::complex<double> * const input_spectrum,const  double* const noise_spectrum)
+void SimpleSpectralSubtraction::computeGain(const std::complex<Real> * const input_spectrum, const Real * const noise_spectrum, Real * const gain)
 {
-#pragma omp parallel for
-	for (auto i = 0U; i < conf.spectrumSize(); ++i)
-	{
-		double Apower, Bpower, magnitude, phase, power;
-
-		power = std::norm(input_spectrum[i]);
-		phase = std::arg(input_spectrum[i]);
-
-		Apower = power - _alpha * noise_spectrum[i];
-		Bpower = _beta * power;
-
-		magnitude = std::sqrt(std::max(Apower, Bpower));
-
-		input_spectrum[i] = {magnitude * std::cos(phase), magnitude * std::sin(phase)};
-	}
+	MathUtil::powerSubtractionGain(input_spectrum, noise_spectrum, _alphaBins->data(), _betaBins->data(), gain, conf.spectrumSize());
 }
 
 void SimpleSpectralSubtraction::onFFTSizeUpdate()
 {
+	updateBinParameters();
+}
 
+void SimpleSpectralSubtraction::updateBinParameters()
+{
+	_alphaBins = std::make_shared<const std::vector<Real>>(conf.spectrumSize(), (Real) _alpha);
+	_betaBins = std::make_shared<const std::vector<Real>>(conf.spectrumSize(), (Real) _beta);
 }
 
 void SimpleSpectralSubtraction::onDataUpdate()
@@ -48,6 +41,11 @@ void SimpleSpectralSubtraction::onDataUpdate()
 
 }
 
+bool SimpleSpectralSubtraction::frameIndependent() const
+{
+	return true;
+}
+
 double SimpleSpectralSubtraction::alpha() const
 {
 	return _alpha;
@@ -56,6 +54,7 @@ double SimpleSpectralSubtraction::alpha() const
 void SimpleSpectralSubtraction::setAlpha(const double value)
 {
 	_alpha = std::max(value,  0.0);
+	updateBinParameters();
 }
 
 double SimpleSpectralSubtraction::beta() const
@@ -66,4 +65,5 @@ double SimpleSpectralSubtraction::beta() const
 void SimpleSpectralSubtraction::setBeta(const double value)
 {
 	_beta = std::max(value,  0.0);
+	updateBinParameters();
 }
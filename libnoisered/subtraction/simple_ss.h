@@ -1,4 +1,6 @@
 #pragma once
+#include <memory>
+#include <vector>
 #include "subtraction_algorithm.h"
 
 /**
@@ -14,14 +16,16 @@ class SimpleSpectralSubtraction : public Subtraction
 		virtual Subtraction* clone() override;
 
 		/**
-		 * @brief Performs spectral subtraction, simple algorithm.
+		 * @brief Computes the gain of the simple spectral subtraction.
 		 *
 		 * @param input_spectrum Input spectrum.
-		 * @param noise_power Estimated noise power.
+		 * @param noise_spectrum Estimated noise power.
+		 * @param gain Output gain.
 		 */
-		virtual void operator()(std::complex<double>* const input_spectrum, const double * const noise_spectrum) override;
+		virtual void computeGain(const std::complex<Real>* const input_spectrum, const Real * const noise_spectrum, Real * const gain) override;
 		virtual void onFFTSizeUpdate() override;
 		virtual void onDataUpdate() override;
+		virtual bool frameIndependent() const override;
 
 		/**
 		 * @brief Returns alpha.
@@ -52,7 +56,18 @@ class SimpleSpectralSubtraction : public Subtraction
 		void setBeta(const double value);
 
 	protected:
+		/**
+		 * @brief Fills the per-bin alpha and beta arrays used by the subtraction kernel.
+		 *
+		 * Called when a parameter or the FFT size changes. The arrays are replaced,
+		 * not modified: clones share them until their own parameters change.
+		 */
+		virtual void updateBinParameters();
+
 		double _alpha =  0.0; /**< TODO */
 		double _beta =  0.0; /**< TODO */
 
+		std::shared_ptr<const std::vector<Real>> _alphaBins = nullptr; /**< Alpha for each bin */
+		std::shared_ptr<const std::vector<Real>> _betaBins = nullptr; /**< Beta for each bin */
+
 };
@@ -10,3 +10,8 @@ Subtraction::~Subtraction()
 {
 
 }
+
+bool Subtraction::frameIndependent() const
+{
+	return false;
+}
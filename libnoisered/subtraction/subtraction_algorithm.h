@@ -1,5 +1,6 @@
 #pragma once
 #include <complex>
+#include "../mathutils/real.h"
 
 class SubtractionManager;
 
@@ -16,11 +17,16 @@ class Subtraction
 		virtual ~Subtraction();
 		virtual Subtraction* clone() = 0;
 		/**
-		 * @brief Functor : performs the subtraction algorithm.
+		 * @brief Computes the gain of each bin: this is the subtraction algorithm.
+		 *
+		 * The spectrum is not modified, the manager applies the gain
+		 * (after flooring / smoothing it) when it prepares the backward FFT.
+		 *
 		 * @param input_spectrum Input spectrum to subtract
 		 * @param noise_spectrum Estimated noise spectrum for this frame.
+		 * @param gain Output, one real gain per bin.
 		 */
-		virtual void operator()(std::complex<double>* const input_spectrum, const double* const noise_spectrum) = 0;
+		virtual void computeGain(const std::complex<Real>* const input_spectrum, const Real* const noise_spectrum, Real* const gain) = 0;
 
 		/**
 		 * @brief Actions to perform if the FFT size changes.
@@ -36,6 +42,15 @@ class Subtraction
 		 */
 		virtual void onDataUpdate() = 0;
 
+		/**
+		 * @brief Tells if the algorithm keeps no state from one frame to the next.
+		 *
+		 * Frame-independent algorithms can be run on several frames concurrently.
+		 *
+		 * @return true if computeGain() only depends on its arguments.
+		 */
+		virtual bool frameIndependent() const;
+
 	protected:
 		const SubtractionManager& conf;
 };
@@ -1,12 +1,32 @@
 #include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
 
 #include "subtraction_manager.h"
+#include "mapped_file.h"
+#include "profiler.h"
 #include "mathutils/math_util.h"
+#include "mathutils/subtraction_kernels.h"
 #include "fft/fftwmanager.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Number of frames processed by each stage of the parallel pipeline before the next stage runs.
+static const unsigned int parallel_block_frames = 64;
+
+static unsigned int threadNumber()
+{
+#ifdef _OPENMP
+	return (unsigned int) omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
 
 SubtractionManager::SubtractionManager(const unsigned int fft_Size, const unsigned int sampling_Rate):
 	_samplingRate(sampling_Rate),
@@ -23,20 +43,44 @@ SubtractionManager::SubtractionManager(const SubtractionManager &sm):
 	_subtraction(nullptr),
 	_estimation(nullptr), //TODO Clone method
 	_tabLength(sm._tabLength),
-	_data(new double[_tabLength]),
-	_origData(new double[_tabLength]),
+	_data(sm._data ? new Real[_tabLength] : nullptr),
+	_origData(sm._origData ? new Real[_tabLength] : nullptr),
+	_pcm(sm._pcm),
+	_inputFile(sm._inputFile),
 	_useOLA(sm._useOLA),
-	_iterations(sm.iterations())
+	_useWOLA(sm._useWOLA),
+	_window(sm._window),
+	_hop(sm._hop),
+	_iterations(sm.iterations()),
+	_fusedIterations(sm.fusedIterations()),
+	_gainFloor(sm._gainFloor),
+	_gainSmoothing(sm._gainSmoothing),
+	_threads(sm.threads())
 
 {
+	// The FFT plans, window tables and the tables of the algorithms are shared,
+	// only the buffers and the state of the algorithms are copied.
 	_fft.reset(sm._fft->clone());
 	_subtraction.reset(sm._subtraction->clone());
 	_estimation.reset(sm._estimation->clone());
 
-	_fft->updateSize(sm._fft->size());
-	onFFTSizeUpdate();
-	std::copy_n(sm._data, _tabLength, _data);
-	std::copy_n(sm._origData, _tabLength, _origData);
+	allocateBuffers();
+	_analysisWindow = sm._analysisWindow;
+	_synthesisWindow = sm._synthesisWindow;
+	copyData(sm);
+
+	std::copy_n(sm._streamIn, _fft->size(), _streamIn);
+	std::copy_n(sm._streamAcc, _fft->size(), _streamAcc);
+	std::copy_n(sm._streamOut, _fft->size(), _streamOut);
+	_streamHead = sm._streamHead;
+	_streamFill = sm._streamFill;
+	std::copy_n(sm._prevGain, spectrumSize(), _prevGain);
+
+	for (const auto& estimation : sm._iterEstimation)
+		_iterEstimation.emplace_back(estimation->clone());
+	for (const auto& subtraction : sm._iterSubtraction)
+		_iterSubtraction.emplace_back(subtraction->clone());
+	_iterPrevGain = sm._iterPrevGain;
 }
 
 const SubtractionManager &SubtractionManager::operator=(const SubtractionManager &sm)
@@ -47,75 +91,391 @@ const SubtractionManager &SubtractionManager::operator=(const SubtractionManager
 	_tabLength = sm._tabLength;
 	delete[] _data;
 	delete[] _origData;
-	_data = new double[_tabLength];
-	_origData = new double[_tabLength];
+	_data = sm._data ? new Real[_tabLength] : nullptr;
+	_origData = sm._origData ? new Real[_tabLength] : nullptr;
+	_pcm = sm._pcm;
+	_inputFile = sm._inputFile;
 	_useOLA = sm._useOLA;
+	_useWOLA = sm._useWOLA;
+	_window = sm._window;
+	_hop = sm._hop;
 	_iterations = sm.iterations();
-
+	_fusedIterations = sm.fusedIterations();
+	_gainFloor = sm._gainFloor;
+	_gainSmoothing = sm._gainSmoothing;
+	_threads = sm.threads();
+	_iterEstimation.clear();
+	_iterSubtraction.clear();
+
+	// The FFT plans, window tables and the tables of the algorithms are shared,
+	// only the buffers and the state of the algorithms are copied.
 	_fft.reset(sm._fft->clone());
 	_subtraction.reset(sm._subtraction->clone());
 	_estimation.reset(sm._estimation->clone());
 
-	_fft->updateSize(sm._fft->size());
-	onFFTSizeUpdate();
-	std::copy_n(sm._data, _tabLength, _data);
-	std::copy_n(sm._origData, _tabLength, _origData);
+	allocateBuffers();
+	_analysisWindow = sm._analysisWindow;
+	_synthesisWindow = sm._synthesisWindow;
+	copyData(sm);
+
+	std::copy_n(sm._streamIn, _fft->size(), _streamIn);
+	std::copy_n(sm._streamAcc, _fft->size(), _streamAcc);
+	std::copy_n(sm._streamOut, _fft->size(), _streamOut);
+	_streamHead = sm._streamHead;
+	_streamFill = sm._streamFill;
+	std::copy_n(sm._prevGain, spectrumSize(), _prevGain);
+
+	for (const auto& estimation : sm._iterEstimation)
+		_iterEstimation.emplace_back(estimation->clone());
+	for (const auto& subtraction : sm._iterSubtraction)
+		_iterSubtraction.emplace_back(subtraction->clone());
+	_iterPrevGain = sm._iterPrevGain;
 
 	return *this;
 }
 
+void SubtractionManager::copyData(const SubtractionManager &sm)
+{
+	if (sm._data) std::copy_n(sm._data, _tabLength, _data);
+	if (sm._origData) std::copy_n(sm._origData, _tabLength, _origData);
+
+	// A buffer not processed yet is still read from the caller's memory, a file from the shared mapping
+	_pcmSource = (sm._pcmSource == sm._pcm.data()) ? _pcm.data() : sm._pcmSource;
+}
+
 
 
 void SubtractionManager::execute()
 {
 	// Some configuration and cleaning according to the parameters used
 	if (bypass()) return;
-	if (dataSource() == DataSource::File)
-	{
+
+	// With one pass (one iteration, or fused iterations), a buffer, or a file written to an
+	// output file, is converted frame by frame in the copies. Otherwise the whole signal is
+	// converted into _data, which keeps the intermediate results of the passes in full precision.
+	_pcmFrames = passes() == 1 && (dataSource() == DataSource::Buffer || _outputFile);
+	if (!_pcmFrames)
 		initDataArray();
+	updateIterationAlgorithms();
+
+	// The estimations which use the output of a frame need it before the next one, and so do
+	// the OLA frames, whose input starts with the second half of the previous output
+	if (dataSource() == DataSource::File && threads() > 1 && !_estimation->usesFrameOutput() && (!_useOLA || _useWOLA))
+	{
+		executeParallel();
 	}
-	// For Julius, call onDataUpdate() on every file change, and only once if it is mic input.
+	else
+	{
+		// For Julius, call onDataUpdate() on every file change, and only once if it is mic input.
 
-	// Execution of the algortihm
-	for (auto iter = 0U; iter < iterations(); ++iter)
+		// Execution of the algortihm. With WOLA, the first frames start before the signal.
+		for (auto iter = 0U; iter < passes(); ++iter)
+		{
+			std::fill_n(_bufferTail, _ola_frame_increment, 0);
+			std::fill_n(_frameAcc, _fft->size(), 0);
+			_frameHead = 0;
+			for (auto sample_n = 0U; sample_n < getLength() + frameLead(); sample_n += getFrameIncrement())
+			{
+				copyInput(sample_n);
+				{
+					NOISERED_PROFILE(ForwardFFT);
+					_fft->forward();
+				}
+
+				if(dataSource() == DataSource::File && sample_n == 0)
+					onDataUpdate();
+
+				// Noise estimation and spectral subtraction, of each iteration if they are fused
+				processSpectrum(_fft->spectrum(), true);
+
+				{
+					NOISERED_PROFILE(BackwardFFT);
+					_fft->backward();
+				}
+				notifyFrameOutput();
+				copyOutput(sample_n);
+			}
+		}
+	}
+
+	// Result held in _data
+	if (!_pcmFrames && _outputFile)
 	{
-		for (auto sample_n = 0U; sample_n < getLength(); sample_n += getFrameIncrement())
+		for (auto pos = 0U; pos < getLength(); pos += (unsigned int) _outputPCM.size())
 		{
-			copyInput(sample_n);
-			_fft->forward();
+			const unsigned int len = std::min((unsigned int) _outputPCM.size(), getLength() - pos);
+			MathUtil::realToShort(_data + pos, _outputPCM.data(), 1, len);
+			writeOutput(_outputPCM.data(), len);
+		}
+	}
+	else if (!_pcmFrames && dataSource() == DataSource::Buffer)
+	{
+		MathUtil::realToShort(_data, _pcm.data(), 1, _tabLength);
+	}
 
-			if(dataSource() == DataSource::File && sample_n == 0)
-				onDataUpdate();
+	if (dataSource() == DataSource::Buffer)
+	{
+		// Buffers are only kept in PCM
+		delete[] _data;
+		_data = nullptr;
 
-			// Noise estimation
-			(*getEstimationImplementation())(_fft->spectrum());
+		// Another execution processes the output again
+		if (!_outputFile) _pcmSource = _pcm.data();
+	}
+}
+
+unsigned int SubtractionManager::executeToFile(const char *path)
+{
+	std::ofstream ofile(path, std::ios_base::binary);
+
+	if (bypass())
+	{
+		ofile.write((const char *) _pcmSource, getLength() * sizeof(short));
+		return getLength();
+	}
+
+	// Room for one block of frames of executeParallel(), also used by the other cases
+	_outputPCM.resize(parallel_block_frames * _fft->size());
+	_outputFile = &ofile;
+	execute();
+	_outputFile = nullptr;
+	_outputPCM = std::vector<short>();
+
+	return getLength();
+}
+
+void SubtractionManager::writeOutput(const short *samples, const unsigned int length)
+{
+	_outputFile->write((const char *) samples, length * sizeof(short));
+}
+
+void SubtractionManager::executeParallel()
+{
+	const unsigned int size = _fft->size();
+	const unsigned int spectrum_size = spectrumSize();
+	const unsigned int hop = getFrameIncrement();
+	const unsigned int lead = frameLead();
+	const unsigned int overlap = size - hop;
+	const unsigned int frames = (getLength() + lead + hop - 1) / hop;
+	const bool concurrent_subtraction = getSubtractionImplementation()->frameIndependent() && gainSmoothing() == 0;
+
+	for (auto iter = 0U; iter < passes(); ++iter)
+	{
+		onDataUpdate();
+		std::fill_n(_blockTail, size, 0);
 
-			// Spectral subtraction
-			(*getSubtractionImplementation())(_fft->spectrum(), getEstimationImplementation()->noisePower());
+		for (auto first = 0U; first < frames; first += parallel_block_frames)
+		{
+			const unsigned int count = std::min(parallel_block_frames, frames - first);
+
+			// 1) Input copy and forward FFT, concurrent
+			#pragma omp parallel for num_threads(_threads)
+			for (auto f = 0U; f < count; ++f)
+			{
+				FFTManager& fft = *_workerFFT[threadNumber()];
+
+				{
+					NOISERED_PROFILE(CopyInput);
+					readFrame((int) ((first + f) * hop) - (int) lead, fft.input());
+				}
+				NOISERED_PROFILE(ForwardFFT);
+				fft.forward();
+				std::copy_n(fft.spectrum(), spectrum_size, _blockSpectra + f * spectrum_size);
+			}
+
+			// 2) Estimation, in frame order. The subtractions of the fused iterations
+			// but the last one need the previous frames too.
+			for (auto f = 0U; f < count; ++f)
+			{
+				std::complex<Real> * const spectrum = _blockSpectra + f * spectrum_size;
+				const Real * const noise = processSpectrum(spectrum, !concurrent_subtraction);
+				std::copy_n(noise, spectrum_size, _blockNoise + f * spectrum_size);
+			}
+
+			// 3) Subtraction and backward FFT, concurrent. The gain is applied
+			// while copying the spectrum into the backward FFT input.
+			#pragma omp parallel for num_threads(_threads)
+			for (auto f = 0U; f < count; ++f)
+			{
+				FFTManager& fft = *_workerFFT[threadNumber()];
+				const std::complex<Real> * const spectrum = _blockSpectra + f * spectrum_size;
+
+				if (concurrent_subtraction)
+				{
+					NOISERED_PROFILE(Subtraction);
+					Real * const gain = _blockGains + f * spectrum_size;
+					getSubtractionImplementation()->computeGain(spectrum, _blockNoise + f * spectrum_size, gain);
+					MathUtil::applyGain(spectrum, fft.spectrum(), gain, gain, _gainFloor, 0, spectrum_size);
+				}
+				else
+				{
+					std::copy_n(spectrum, spectrum_size, fft.spectrum());
+				}
+
+				NOISERED_PROFILE(BackwardFFT);
+				fft.backward();
+				std::transform(fft.output(), fft.output() + size, _synthesisWindow->begin(), _blockFrames + f * size,
+							   std::multiplies<Real>());
+			}
+
+			// 4) Overlap-add. Each frame owns the hop-long tile where it starts, so no two
+			// threads write to the same sample. The tiles only cover input already consumed.
+			// Without _data, the tile is summed in place (only its own frame reads it) and converted.
+			#pragma omp parallel for num_threads(_threads)
+			for (auto f = 0U; f < count; ++f)
+			{
+				NOISERED_PROFILE(CopyOutput);
+				Real * const frame = _blockFrames + f * size;
+				const int pos = (int) ((first + f) * hop) - (int) lead;
+				const unsigned int skip = pos < 0 ? (unsigned int) -pos : 0;
+				const unsigned int end = std::min(hop, (unsigned int) ((int) getLength() - pos));
+				Real * const tile = _pcmFrames ? frame + skip : _data + (pos + (int) skip);
+
+				for (auto j = skip; j < end; ++j)
+				{
+					// The frames started in the previous hops, then those of the previous block
+					Real sum = frame[j];
+					for (auto r = 1U; r <= f && r * hop < size; ++r)
+						sum += _blockFrames[(f - r) * size + r * hop + j];
+					if (f * hop + j < overlap)
+						sum += _blockTail[f * hop + j];
+					tile[j - skip] = sum;
+				}
+
+				if (_pcmFrames && skip < end)
+					MathUtil::realToShort(tile, _outputPCM.data() + f * hop + skip, 1, end - skip);
+			}
+
+			// Parts of the frames of this block (and the previous ones) after its last tile
+			for (auto x = 0U; x < overlap; ++x)
+			{
+				Real sum = count * hop + x < overlap ? _blockTail[count * hop + x] : 0;
+				for (auto r = 1U; r <= count && r * hop + x < size; ++r)
+					sum += _blockFrames[(count - r) * size + r * hop + x];
+				_blockTail[x] = sum;
+			}
 
-			_fft->backward();
-			copyOutput(sample_n);
+			if (_pcmFrames)
+			{
+				const unsigned int block = first * hop;
+				const unsigned int from = block < lead ? lead - block : 0;
+				const unsigned int to = std::min(count * hop, getLength() + lead - block);
+				if (from < to)
+					writeOutput(_outputPCM.data() + from, to - from);
+			}
 		}
 	}
 }
 
+void SubtractionManager::onThreadsUpdate()
+{
+	_workerFFT.clear();
+	delete[] _blockSpectra;
+	delete[] _blockNoise;
+	delete[] _blockGains;
+	delete[] _blockFrames;
+	delete[] _blockTail;
+	_blockSpectra = nullptr;
+	_blockNoise = nullptr;
+	_blockGains = nullptr;
+	_blockFrames = nullptr;
+	_blockTail = nullptr;
+
+	// Sequential processing only uses _fft
+	if (_threads < 2) return;
+
+	// The plans are shared: the clones only allocate their buffers.
+	for (auto i = 0U; i < _threads; ++i)
+	{
+		_workerFFT.push_back(FFT_p(_fft->clone()));
+	}
+
+	_blockSpectra = new std::complex<Real>[parallel_block_frames * spectrumSize()];
+	_blockNoise = new Real[parallel_block_frames * spectrumSize()];
+	_blockGains = new Real[parallel_block_frames * spectrumSize()];
+	_blockFrames = new Real[parallel_block_frames * _fft->size()];
+	_blockTail = new Real[_fft->size()];
+}
+
+double SubtractionManager::gainFloor() const
+{
+	return _gainFloor;
+}
+
+void SubtractionManager::setGainFloor(const double value)
+{
+	_gainFloor = (Real) std::max(value, 0.0);
+}
 
+double SubtractionManager::gainSmoothing() const
+{
+	return _gainSmoothing;
+}
+
+void SubtractionManager::setGainSmoothing(const double value)
+{
+	_gainSmoothing = (Real) std::min(std::max(value, 0.0), 1.0);
+}
+
+unsigned int SubtractionManager::threads() const
+{
+	return _threads;
+}
+
+void SubtractionManager::setThreads(const unsigned int value)
+{
+	_threads = std::max(value, 1U);
+	onThreadsUpdate();
+}
 
 void SubtractionManager::onFFTSizeUpdate()
 {
-	if(_bypass) return;
+	allocateBuffers();
+	updateWindows();
 
-	_ola_frame_increment = _fft->size() / 2;
-	_std_frame_increment = _fft->size();
+	if(_bypass) return;
 
 	if(_estimation) _estimation->onFFTSizeUpdate();
 	if(_subtraction) _subtraction->onFFTSizeUpdate();
+	_iterEstimation.clear();
+	_iterSubtraction.clear();
+}
+
+void SubtractionManager::allocateBuffers()
+{
+	_ola_frame_increment = _fft->size() / 2;
+	_std_frame_increment = _fft->size();
+	_wola_frame_increment = _fft->size() / (_hop == Hop::Quarter ? 4 : 2);
+
+	// Stream buffers must follow the size even when bypassed,
+	// since bypass can be disabled later on.
+	delete[] _streamIn;
+	delete[] _streamAcc;
+	delete[] _streamOut;
+	delete[] _bufferTail;
+	delete[] _frameAcc;
+	_streamIn = new Real[_fft->size()];
+	_streamAcc = new Real[_fft->size()];
+	_streamOut = new Real[_fft->size()];
+	_bufferTail = new Real[_ola_frame_increment];
+	_frameAcc = new Real[_fft->size()];
+	resetStream();
+	onThreadsUpdate();
+
+	delete[] _gain;
+	delete[] _prevGain;
+	_gain = new Real[spectrumSize()];
+	_prevGain = new Real[spectrumSize()];
+	std::fill_n(_prevGain, spectrumSize(), 1);
 }
 
 
 void SubtractionManager::copyInput(const unsigned int pos)
 {
-	if(_useOLA)
+	NOISERED_PROFILE(CopyInput);
+	if(_useWOLA)
+		copyInputWOLA(pos);
+	else if(_useOLA)
 		copyInputOLA(pos);
 	else
 		copyInputSimple(pos);
@@ -123,7 +483,10 @@ void SubtractionManager::copyInput(const unsigned int pos)
 
 void SubtractionManager::copyOutput(const unsigned int pos)
 {
-	if(_useOLA)
+	NOISERED_PROFILE(CopyOutput);
+	if(_useWOLA)
+		copyOutputWOLA(pos);
+	else if(_useOLA)
 		copyOutputOLA(pos);
 	else
 		copyOutputSimple(pos);
@@ -137,11 +500,24 @@ SubtractionManager::~SubtractionManager()
 
 	delete[] _data;
 	delete[] _origData;
+	delete[] _streamIn;
+	delete[] _streamAcc;
+	delete[] _streamOut;
+	delete[] _bufferTail;
+	delete[] _frameAcc;
+	delete[] _blockSpectra;
+	delete[] _blockNoise;
+	delete[] _blockGains;
+	delete[] _blockFrames;
+	delete[] _blockTail;
+	delete[] _gain;
+	delete[] _prevGain;
 }
 
 void SubtractionManager::initDataArray()
 {
-	std::copy_n(_origData, _tabLength, _data);
+	if (!_data) _data = new Real[_tabLength];
+	MathUtil::shortToReal(_pcmSource, _data, _tabLength);
 }
 
 unsigned int SubtractionManager::iterations() const
@@ -154,8 +530,46 @@ void SubtractionManager::setIterations(const unsigned int value)
 	_iterations = std::max(value, 1U);
 }
 
+bool SubtractionManager::fusedIterations() const
+{
+	return _fusedIterations;
+}
+
+void SubtractionManager::setFusedIterations(const bool value)
+{
+	_fusedIterations = value;
+}
+
+unsigned int SubtractionManager::frameIterations() const
+{
+	return _fusedIterations ? _iterations : 1;
+}
+
+unsigned int SubtractionManager::passes() const
+{
+	return _fusedIterations ? 1 : _iterations;
+}
+
+void SubtractionManager::updateIterationAlgorithms()
+{
+	const unsigned int extra = frameIterations() - 1;
+	if (_iterEstimation.size() == extra) return;
+
+	// Each iteration starts from the initial state, like the later passes of a file
+	_iterEstimation.clear();
+	_iterSubtraction.clear();
+	for (auto k = 0U; k < extra; ++k)
+	{
+		_iterEstimation.emplace_back(_estimation->clone());
+		_iterSubtraction.emplace_back(_subtraction->clone());
+		_iterEstimation.back()->onDataUpdate();
+		_iterSubtraction.back()->onDataUpdate();
+	}
+	_iterPrevGain.assign(extra * spectrumSize(), 1);
+}
+
 
-double *SubtractionManager::getData() const
+Real *SubtractionManager::getData() const
 {
 	return _data;
 }
@@ -163,12 +577,25 @@ double *SubtractionManager::getData() const
 void SubtractionManager::onDataUpdate()
 {
 	if(_bypass) return;
+	std::fill_n(_prevGain, spectrumSize(), 1);
 	_estimation->onDataUpdate();
 	_subtraction->onDataUpdate();
+
+	std::fill(_iterPrevGain.begin(), _iterPrevGain.end(), 1);
+	for (const auto& estimation : _iterEstimation)
+		estimation->onDataUpdate();
+	for (const auto& subtraction : _iterSubtraction)
+		subtraction->onDataUpdate();
 }
 
-double *SubtractionManager::getNoisyData()
+Real *SubtractionManager::getNoisyData()
 {
+	// Only converted when needed, files are processed from the mapping
+	if (!_origData && _inputFile)
+	{
+		_origData = new Real[_tabLength];
+		MathUtil::shortToReal(_pcmSource, _origData, _tabLength);
+	}
 	return _origData;
 }
 
@@ -179,25 +606,17 @@ unsigned int SubtractionManager::getLength() const
 
 unsigned int SubtractionManager::readFile(const char *str)
 {
-	std::ifstream ifile(str, std::ios_base::ate | std::ios_base::binary);
-	_tabLength = ((unsigned int) ifile.tellg()) / (unsigned int) (sizeof(short) / sizeof(char));
-	ifile.clear();
-	ifile.seekg(0, std::ios_base::beg);
-
 	delete[] _origData;
 	delete[] _data;
-	_origData = new double[_tabLength];
-	_data = new double[_tabLength];
+	_origData = nullptr;
+	_data = nullptr;
 
-	unsigned int pos = 0;
-	short sample;
+	// The samples are converted when the frames are copied (or by execute() into _data),
+	// the file is only mapped here.
+	_inputFile = std::make_shared<MappedFile>(str);
+	_pcmSource = reinterpret_cast<const short *>(_inputFile->data());
+	_tabLength = (unsigned int) (_inputFile->size() / sizeof(short));
 
-	while (ifile.read((char *)&sample, sizeof(short)))
-	{
-		_origData[pos++] = MathUtil::ShortToDouble(sample);
-	}
-
-	ifile.close();
 	_dataSource = DataSource::File;
 	return _tabLength;
 }
@@ -208,19 +627,22 @@ unsigned int SubtractionManager::readBuffer(const short *buffer, const unsigned
 
 	_tabLength = length;
 
+	// No full-length floating point copy: the samples are converted frame by frame
+	// when they are copied into the FFT input, and the output is converted back
+	// the same way into _pcm. The buffer is read during execute().
 	delete[] _origData;
 	delete[] _data;
-	_origData = new double[_tabLength];
-	_data = new double[_tabLength];
+	_origData = nullptr;
+	_data = nullptr;
+	_inputFile.reset();
+	_pcmSource = buffer;
+	_pcm.resize(_tabLength);
 
 	// Julius accepts only big-endian raw files but it seems internal buffers
 	// are little-endian so no need to convert.
 	// std::transform(buffer, buffer + tab_length, buffer,
 	//                [] (short val) {return (val << 8) | ((val >> 8) & 0xFF)});
 
-	std::transform(buffer, buffer + _tabLength, _origData, MathUtil::ShortToDouble);
-	initDataArray();
-
 	_dataSource = DataSource::Buffer;
 	return _tabLength;
 }
@@ -228,7 +650,10 @@ unsigned int SubtractionManager::readBuffer(const short *buffer, const unsigned
 void SubtractionManager::writeBuffer(short * const buffer) const
 {
 	if(_bypass) return;
-	std::transform(_data, _data + _tabLength, buffer, MathUtil::DoubleToShort);
+	if (dataSource() == DataSource::Buffer)
+		std::copy(_pcm.begin(), _pcm.end(), buffer);
+	else if (_data)
+		MathUtil::realToShort(_data, buffer, 1, _tabLength);
 
 	// Julius accepts only big-endian raw files but it seems internal buffers
 	// are little-endian so no need to convert.
@@ -236,8 +661,175 @@ void SubtractionManager::writeBuffer(short * const buffer) const
 	//                [] (short val) {return (val << 8) | ((val >> 8) & 0xFF)});
 }
 
+unsigned int SubtractionManager::process(const short *in, short *out, const unsigned int n)
+{
+	if(_bypass)
+	{
+		if(in != out) std::copy_n(in, n, out);
+		return n;
+	}
+
+	const unsigned int hop = getFrameIncrement();
+	Real * const input = _streamIn + frameLead();
+	updateIterationAlgorithms();
+	auto done = 0U;
+	while (done < n)
+	{
+		const unsigned int len = std::min(n - done, hop - _streamFill);
+
+		// Input is read before output is written, so that in and out may alias.
+		MathUtil::shortToReal(in + done, input + _streamFill, len);
+		MathUtil::realToShort(_streamOut + _streamFill, out + done, 1, len);
+
+		_streamFill += len;
+		done += len;
+
+		if (_streamFill == hop)
+		{
+			processStreamFrame();
+			_streamFill = 0;
+		}
+	}
+
+	return n;
+}
+
+void SubtractionManager::processStreamFrame()
+{
+	const unsigned int size = _fft->size();
+	const unsigned int hop = getFrameIncrement();
+	const unsigned int length = frameInputLength();
+	Real * const input = _fft->input();
+
+	{
+		NOISERED_PROFILE(CopyInput);
+
+		// Windowing (WOLA) or zero-padding (OLA)
+		if (_useWOLA)
+			std::transform(_streamIn, _streamIn + length, _analysisWindow->begin(), input, std::multiplies<Real>());
+		else
+			std::copy_n(_streamIn, length, input);
+		std::fill(input + length, input + size, 0);
+
+		// The end of the frame is the beginning of the next one
+		std::copy(_streamIn + hop, _streamIn + length, _streamIn);
+	}
+
+	{
+		NOISERED_PROFILE(ForwardFFT);
+		_fft->forward();
+	}
+	processSpectrum(_fft->spectrum(), true);
+	{
+		NOISERED_PROFILE(BackwardFFT);
+		_fft->backward();
+	}
+	notifyFrameOutput();
+
+	// Overlap-add into the circular accumulator
+	NOISERED_PROFILE(CopyOutput);
+	Real * const done = overlapAdd(_streamAcc, _streamHead);
+	std::copy_n(done, hop, _streamOut);
+	std::fill_n(done, hop, 0);
+	_streamHead = (_streamHead + hop) % size;
+}
+
+Real *SubtractionManager::overlapAdd(Real * const acc, const unsigned int head) const
+{
+	const unsigned int size = _fft->size();
+	const Real * const frame = _fft->output();
+	const Real * const window = _synthesisWindow->data();
+	const unsigned int wrap = size - head;
+	for (auto j = 0U; j < wrap; ++j)
+		acc[head + j] += frame[j] * window[j];
+	for (auto j = wrap; j < size; ++j)
+		acc[j - wrap] += frame[j] * window[j];
+
+	// No later frame overlaps the first hop samples: they are complete.
+	return acc + head;
+}
+
+void SubtractionManager::subtract(const std::complex<Real> * const in, const Real * const noise, std::complex<Real> * const out)
+{
+	getSubtractionImplementation()->computeGain(in, noise, _gain);
+	MathUtil::applyGain(in, out, _gain, _prevGain, _gainFloor, _gainSmoothing, spectrumSize());
+	std::swap(_gain, _prevGain);
+}
+
+void SubtractionManager::subtract(const std::complex<Real> * const in, const Real * const noise, std::complex<Real> * const out, const unsigned int iteration)
+{
+	NOISERED_PROFILE(Subtraction);
+	if (iteration == 0)
+	{
+		subtract(in, noise, out);
+		return;
+	}
+
+	Real * const prev_gain = _iterPrevGain.data() + (iteration - 1) * spectrumSize();
+	_iterSubtraction[iteration - 1]->computeGain(in, noise, _gain);
+	MathUtil::applyGain(in, out, _gain, prev_gain, _gainFloor, _gainSmoothing, spectrumSize());
+	std::copy_n(_gain, spectrumSize(), prev_gain);
+}
+
+const Real *SubtractionManager::processSpectrum(std::complex<Real> * const spectrum, const bool subtract_last)
+{
+	// The spectrum stays in cache from one iteration to the next
+	const unsigned int n = frameIterations();
+	const Real *noise = nullptr;
+	for (auto k = 0U; k < n; ++k)
+	{
+		Estimation& estimation = k == 0 ? *_estimation : *_iterEstimation[k - 1];
+		{
+			NOISERED_PROFILE(Estimation);
+			estimation(spectrum);
+			noise = estimation.noisePower();
+		}
+
+		if (subtract_last || k + 1 < n)
+			subtract(spectrum, noise, spectrum, k);
+	}
+
+	return noise;
+}
+
+void SubtractionManager::notifyFrameOutput()
+{
+	if (!_estimation->usesFrameOutput()) return;
+
+	NOISERED_PROFILE(FrameOutput);
+	const unsigned int n = frameIterations();
+	for (auto k = 0U; k < n; ++k)
+	{
+		Estimation& estimation = k == 0 ? *_estimation : *_iterEstimation[k - 1];
+		const Real * const gain = k == 0 ? _prevGain : _iterPrevGain.data() + (k - 1) * spectrumSize();
+		estimation.onFrameOutput(gain, _fft->output());
+	}
+}
+
+void SubtractionManager::resetStream()
+{
+	std::fill_n(_streamIn, _fft->size(), 0);
+	std::fill_n(_streamAcc, _fft->size(), 0);
+	std::fill_n(_streamOut, _fft->size(), 0);
+	_streamHead = 0;
+	_streamFill = 0;
+}
+
+unsigned int SubtractionManager::streamLatency() const
+{
+	return frameLead() + getFrameIncrement();
+}
+
 void SubtractionManager::copyInputSimple(const unsigned int pos)
 {
+	if (_pcmFrames)
+	{
+		const unsigned int len = std::min(_fft->size(), _tabLength - pos);
+		MathUtil::shortToReal(_pcmSource + pos, _fft->input(), len);
+		std::fill(_fft->input() + len, _fft->input() + _fft->size(), 0);
+		return;
+	}
+
 	// Data copying
 	if (_fft->size() <= _tabLength - pos)
 	{
@@ -250,9 +842,29 @@ void SubtractionManager::copyInputSimple(const unsigned int pos)
 	}
 }
 
+void SubtractionManager::outputFrame(const Real * const samples, const Real scale, const unsigned int pos, const unsigned int length)
+{
+	// Buffers are written in place, files block by block
+	if (_outputFile)
+	{
+		MathUtil::realToShort(samples, _outputPCM.data(), scale, length);
+		writeOutput(_outputPCM.data(), length);
+	}
+	else
+	{
+		MathUtil::realToShort(samples, _pcm.data() + pos, scale, length);
+	}
+}
+
 void SubtractionManager::copyOutputSimple(const unsigned int pos)
 {
-	auto normalizeFFT = [&](double x) { return x * _fft->normalizationFactor(); };
+	if (_pcmFrames)
+	{
+		outputFrame(_fft->output(), _fft->normalizationFactor(), pos, std::min(_fft->size(), _tabLength - pos));
+		return;
+	}
+
+	auto normalizeFFT = [&](Real x) { return x * _fft->normalizationFactor(); };
 	if (_fft->size() <= _tabLength - pos)
 	{
 		std::transform(_fft->output(), _fft->output() + _fft->size(), _data + pos, normalizeFFT);
@@ -265,6 +877,18 @@ void SubtractionManager::copyOutputSimple(const unsigned int pos)
 
 void SubtractionManager::copyInputOLA(const unsigned int pos)
 {
+	if (_pcmFrames)
+	{
+		// Same frame as below: the input samples, plus the tail of the previous frame.
+		const unsigned int len = std::min(_ola_frame_increment, _tabLength - pos);
+		Real * const input = _fft->input();
+		MathUtil::shortToReal(_pcmSource + pos, input, len);
+		for (auto j = 0U; j < len; ++j)
+			input[j] += _bufferTail[j];
+		std::fill(input + len, input + _fft->size(), 0);
+		return;
+	}
+
 	// Data copying
 	if (_ola_frame_increment <= _tabLength - pos) // last case
 	{
@@ -284,15 +908,141 @@ void SubtractionManager::copyInputOLA(const unsigned int pos)
 
 void SubtractionManager::copyOutputOLA(const unsigned int pos)
 {
+	if (_pcmFrames)
+	{
+		// The first half is complete, the second one is kept for the next frame.
+		const unsigned int hop = _ola_frame_increment;
+		const Real norm = _fft->normalizationFactor();
+		const Real * const output = _fft->output();
+		outputFrame(output, norm, pos, std::min(hop, _tabLength - pos));
+		std::transform(output + hop, output + 2 * hop, _bufferTail, [norm] (Real x) { return x * norm; });
+		return;
+	}
+
 	// Lock here
 	//ola_mutex.lock();
 	for (auto j = 0U; (j < _fft->size()) && (pos + j < _tabLength); ++j)
 	{
-		_data[pos + j] += _fft->output()[j] / _fft->size();
+		_data[pos + j] += _fft->output()[j] / (Real) _fft->size();
 	}
 	// Unlock here
 	//ola_mutex.unlock();
 }
+void SubtractionManager::copyInputWOLA(const unsigned int pos)
+{
+	readFrame((int) pos - (int) frameLead(), _fft->input());
+}
+
+void SubtractionManager::copyOutputWOLA(const unsigned int pos)
+{
+	const unsigned int hop = _wola_frame_increment;
+	Real * const done = overlapAdd(_frameAcc, _frameHead);
+
+	// The completed hop starts where the frame does, maybe before the signal
+	const int start = (int) pos - (int) frameLead();
+	const unsigned int skip = start < 0 ? (unsigned int) -start : 0;
+	if (skip < hop && start + (int) skip < (int) _tabLength)
+	{
+		const unsigned int first = (unsigned int) start + skip;
+		const unsigned int len = std::min(hop - skip, _tabLength - first);
+		if (_pcmFrames)
+			outputFrame(done + skip, 1, first, len);
+		else
+			std::copy_n(done + skip, len, _data + first);
+	}
+
+	std::fill_n(done, hop, 0);
+	_frameHead = (_frameHead + hop) % _fft->size();
+}
+
+void SubtractionManager::readFrame(const int start, Real * const input) const
+{
+	const unsigned int size = _fft->size();
+	const unsigned int length = frameInputLength();
+
+	// Zeros before and after the signal
+	const unsigned int skip = start < 0 ? (unsigned int) -start : 0;
+	const int first = start + (int) skip;
+	const unsigned int len = first < (int) _tabLength ? std::min(length - skip, _tabLength - (unsigned int) first) : 0;
+
+	std::fill_n(input, skip, 0);
+	if (_pcmFrames)
+		MathUtil::shortToReal(_pcmSource + first, input + skip, len);
+	else
+		std::copy_n(_data + first, len, input + skip);
+	std::fill(input + skip + len, input + size, 0);
+
+	if (_useWOLA)
+		std::transform(input, input + size, _analysisWindow->begin(), input, std::multiplies<Real>());
+}
+
+unsigned int SubtractionManager::frameInputLength() const
+{
+	return (_useOLA && !_useWOLA) ? _ola_frame_increment : _fft->size();
+}
+
+unsigned int SubtractionManager::frameLead() const
+{
+	return _useWOLA ? _fft->size() - _wola_frame_increment : 0;
+}
+
+void SubtractionManager::updateWindows()
+{
+	const unsigned int size = _fft->size();
+	const Real norm = _fft->normalizationFactor();
+	std::vector<Real> analysis(size, 1);
+	std::vector<Real> synthesis(size, norm);
+	if (!_useWOLA)
+	{
+		_analysisWindow = std::make_shared<const std::vector<Real>>(std::move(analysis));
+		_synthesisWindow = std::make_shared<const std::vector<Real>>(std::move(synthesis));
+		return;
+	}
+
+	// Periodic windows: the frames repeat every hop without overlapping maxima
+	const double pi = std::acos(-1.);
+	std::vector<double> w(size);
+	for (auto j = 0U; j < size; ++j)
+	{
+		const double c = std::cos(2 * pi * j / size);
+		switch (_window)
+		{
+			case Window::Hann: w[j] = 0.5 - 0.5 * c; break;
+			case Window::Hamming: w[j] = 0.54 - 0.46 * c; break;
+			case Window::SqrtHann:
+			default: w[j] = std::sqrt(0.5 - 0.5 * c); break;
+		}
+	}
+
+	// Synthesis: w / sum of w^2 over the overlapping frames, and the FFT normalization
+	const unsigned int hop = _wola_frame_increment;
+	for (auto j = 0U; j < size; ++j)
+	{
+		double overlap = 0;
+		for (auto k = j % hop; k < size; k += hop)
+			overlap += w[k] * w[k];
+		analysis[j] = (Real) w[j];
+		synthesis[j] = (Real) (w[j] / overlap * norm);
+	}
+	_analysisWindow = std::make_shared<const std::vector<Real>>(std::move(analysis));
+	_synthesisWindow = std::make_shared<const std::vector<Real>>(std::move(synthesis));
+}
+
+void SubtractionManager::enableWOLA(const Window window, const Hop hop)
+{
+	_useWOLA = true;
+	_window = window;
+	_hop = hop;
+	_wola_frame_increment = _fft->size() / (_hop == Hop::Quarter ? 4 : 2);
+	updateWindows();
+	resetStream();
+}
+
+bool SubtractionManager::WOLAenabled() const
+{
+	return _useWOLA;
+}
+
 bool SubtractionManager::OLAenabled() const
 {
 	return _useOLA;
@@ -301,16 +1051,25 @@ bool SubtractionManager::OLAenabled() const
 void SubtractionManager::enableOLA()
 {
 	_useOLA = true;
+	_useWOLA = false;
+	updateWindows();
+	resetStream();
 }
 
 void SubtractionManager::disableOLA()
 {
 	_useOLA = false;
+	_useWOLA = false;
+	updateWindows();
+	resetStream();
 }
 
 void SubtractionManager::setOLA(const bool val)
 {
 	_useOLA = val;
+	_useWOLA = false;
+	updateWindows();
+	resetStream();
 }
 
 
@@ -328,6 +1087,8 @@ void SubtractionManager::setEstimationImplementation(Estimation * value)
 {
 	_estimation.reset(value);
 	_estimation->onFFTSizeUpdate();
+	_iterEstimation.clear();
+	_iterSubtraction.clear();
 }
 
 bool SubtractionManager::bypass()
@@ -338,6 +1099,7 @@ bool SubtractionManager::bypass()
 
 unsigned int SubtractionManager::getFrameIncrement() const
 {
+	if (_useWOLA) return _wola_frame_increment;
 	return _useOLA? _ola_frame_increment : _std_frame_increment;
 }
 
@@ -350,6 +1112,8 @@ void SubtractionManager::setSubtractionImplementation(Subtraction *value)
 {
 	_subtraction.reset(value);
 	_subtraction->onFFTSizeUpdate();
+	_iterEstimation.clear();
+	_iterSubtraction.clear();
 }
 
 unsigned int SubtractionManager::getSamplingRate() const
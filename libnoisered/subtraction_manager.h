@@ -1,7 +1,9 @@
 #pragma once
 
 #include <fftw3.h>
+#include <iosfwd>
 #include <memory>
+#include <vector>
 
 #include "subtraction/algorithms.h"
 #include "estimation/algorithms.h"
@@ -11,6 +13,8 @@ typedef std::shared_ptr<Subtraction> Subtraction_p;
 typedef std::shared_ptr<Estimation> Estimation_p;
 typedef std::shared_ptr<FFTManager> FFT_p;
 
+class MappedFile;
+
 /**
  * @brief Main class.
  *
@@ -20,6 +24,12 @@ class SubtractionManager
 	public:
 		enum DataSource { File, Buffer };
 
+		//! Analysis / synthesis window of the weighted overlap-add.
+		enum class Window { Hann, SqrtHann, Hamming };
+
+		//! Hop of the weighted overlap-add, in fraction of the FFT size.
+		enum class Hop { Half, Quarter };
+
 		/**
 		 * @brief Constructor
 		 *
@@ -38,9 +48,11 @@ class SubtractionManager
 		/**
 		 * @brief Returns the modified buffer (the subtracted one).
 		 *
-		 * @return double Pointer to the modified buffer.
+		 * Only for files: buffers given to readBuffer() are kept in PCM, use writeBuffer().
+		 *
+		 * @return Real Pointer to the modified buffer, nullptr for buffers.
 		 */
-		double *getData() const;
+		Real *getData() const;
 
 		/**
 		 * @brief Generates all the data needed from the given parameters
@@ -59,13 +71,17 @@ class SubtractionManager
 		/**
 		 * @brief Returns the original buffer, to perform NRR computation for instance.
 		 *
-		 * @return double Pointer to the original buffer.
+		 * Only for files, like getData().
+		 *
+		 * @return Real Pointer to the original buffer, nullptr for buffers.
 		 */
-		double *getNoisyData();
+		Real *getNoisyData();
 
 		/**
 		 * @brief Reads a file into the internal buffer.
 		 *
+		 * The file is memory-mapped, not loaded: its samples are converted when execute() needs them.
+		 *
 		 * @param str Path to the file.
 		 * @return unsigned int Size of the file.
 		 */
@@ -74,6 +90,9 @@ class SubtractionManager
 		/**
 		 * @brief Reads a buffer into the internal buffer.
 		 *
+		 * The samples are not copied: they are converted frame by frame during execute(),
+		 * so the buffer must stay valid until then. It can be the buffer given to writeBuffer().
+		 *
 		 * @param buffer Short buffer to read from.
 		 * @param length Length of the buffer.
 		 * @return unsigned int Length of the buffer (useless?).
@@ -83,14 +102,48 @@ class SubtractionManager
 		/**
 		 * @brief Writes into a buffer.
 		 *
+		 * Samples out of the -1 / 1 range saturate.
+		 *
 		 * @param buffer Pointer to the buffer to write to.
 		 */
 		void writeBuffer(short * const buffer) const;
 
+		/**
+		 * @brief Streaming entry point: processes the next n samples of a continuous stream.
+		 *
+		 * Unlike readBuffer / execute / writeBuffer, the frame being filled and the
+		 * overlap-add tail are kept from one call to the next, so fragment boundaries
+		 * do not cut frames and no allocation is performed.
+		 * The output is delayed by streamLatency() samples.
+		 *
+		 * in and out may point to the same buffer.
+		 *
+		 * @param in Input samples.
+		 * @param out Output samples.
+		 * @param n Number of samples to process.
+		 * @return unsigned int Number of samples written (always n).
+		 */
+		unsigned int process(const short * in, short * out, const unsigned int n);
+
+		/**
+		 * @brief Discards the partial frame and overlap-add tail of the stream.
+		 */
+		void resetStream();
+
+		/**
+		 * @brief Returns the delay introduced by process(), in samples.
+		 *
+		 * One hop, plus the rest of the frame with WOLA.
+		 *
+		 * @return unsigned int Latency.
+		 */
+		unsigned int streamLatency() const;
+
 		/**
 		 * @brief Undoes all change on the processed audio data.
 		 *
-		 * Effectively copies orig_data into data.
+		 * Effectively converts the input samples into data (for a buffer, the
+		 * output of the previous execution if there was one).
 		 *
 		 */
 		void initDataArray();
@@ -110,6 +163,33 @@ class SubtractionManager
 		 */
 		void setIterations(const unsigned int value);
 
+		/**
+		 * @brief Tells if the iterations are applied frame by frame.
+		 *
+		 * @return bool true if the iterations are fused.
+		 */
+		bool fusedIterations() const;
+
+		/**
+		 * @brief Applies all the iterations to each frame in a single pass, instead of one pass over the signal per iteration.
+		 *
+		 * The spectrum of a frame goes through the estimation and the subtraction of every
+		 * iteration while it is in cache, then through a single backward FFT. Each iteration
+		 * keeps its own copy of the algorithms (and of their state), as it would with separate passes.
+		 * process() also applies the iterations when they are fused.
+		 *
+		 * With simple frames, the result matches the multi-pass one within rounding (1e-9 of the
+		 * peak in double precision, 1 PCM step in single precision), except for a last incomplete
+		 * frame, which the passes truncate to the signal length in between.
+		 * With OLA and WOLA, the frames of a later pass also contain the overlapping parts of the
+		 * previous pass output, which the fused frames do not see. The difference, relative to
+		 * the output power with 2 or 3 iterations, is then about -25 to -35 dB with the simple
+		 * subtraction, -40 to -65 dB with equal loudness, and -5 to -20 dB with the geometric approach.
+		 *
+		 * @param value true to fuse the iterations.
+		 */
+		void setFusedIterations(const bool value);
+
 
 		/**
 		 * @brief Returns the chosen FFT size.
@@ -228,12 +308,102 @@ class SubtractionManager
 		 */
 		bool OLAenabled() const;
 
+		/**
+		 * @brief Enables weighted overlap-add (WOLA), instead of OLA or simple frames.
+		 *
+		 * Frames of FFT size overlap by 1/2 or 3/4 of their length. They are weighted by the analysis
+		 * window before the forward FFT, and by a synthesis window after the backward FFT. The synthesis
+		 * window is the analysis window divided by the sum of the squared windows of the overlapping
+		 * frames: without subtraction, the signal is reconstructed exactly. The smooth frame edges
+		 * avoid most of the artifacts that otherwise require several iterations.
+		 *
+		 * enableOLA(), disableOLA() and setOLA() go back to unweighted frames.
+		 *
+		 * @param window Analysis window. SqrtHann gives a Hann window overall.
+		 * @param hop Distance between the frames.
+		 */
+		void enableWOLA(const Window window = Window::SqrtHann, const Hop hop = Hop::Half);
+		/**
+		 * @brief WOLAenabled
+		 * @return true if weighted overlap-add is enabled.
+		 */
+		bool WOLAenabled() const;
+
 		/**
 		 * @brief execute Runs the algorithm.
 		 */
 		void execute();
 
+		/**
+		 * @brief Runs the algorithm and writes the output to a PCM file, as it is computed.
+		 *
+		 * With one iteration (or fused iterations), the input is converted frame by frame and
+		 * only a block of frames is held in memory, whatever the length of the input: nothing is
+		 * kept for getData(). With several passes, the whole signal is processed
+		 * in memory like with execute(), then written.
+		 *
+		 * @param path Path of the output file. Same format as readFile().
+		 * @return unsigned int Number of samples written.
+		 */
+		unsigned int executeToFile(const char * path);
+
+		/**
+		 * @brief Returns the minimum gain applied to a bin.
+		 *
+		 * @return double Gain floor.
+		 */
+		double gainFloor() const;
+
+		/**
+		 * @brief Sets the minimum gain applied to a bin.
+		 *
+		 * Applied in the same pass as the gain itself, after the subtraction algorithm.
+		 *
+		 * @param value Gain floor, 0 (default) to disable.
+		 */
+		void setGainFloor(const double value);
+
+		/**
+		 * @brief Returns the weight of the previous frame's gain.
+		 *
+		 * @return double Smoothing factor.
+		 */
+		double gainSmoothing() const;
+
+		/**
+		 * @brief Sets the weight of the previous frame's gain (first-order recursive smoothing).
+		 *
+		 * Applied in the same pass as the gain itself, after the subtraction algorithm.
+		 * A non-zero smoothing makes the subtraction order-dependent.
+		 *
+		 * @param value Smoothing factor, between 0 (default, disabled) and 1.
+		 */
+		void setGainSmoothing(const double value);
+
+		/**
+		 * @brief Returns the number of threads used for file processing.
+		 *
+		 * @return unsigned int Number of threads.
+		 */
+		unsigned int threads() const;
+
+		/**
+		 * @brief Sets the number of threads used for file processing.
+		 *
+		 * With more than one thread, execute() on a file runs the FFTs (and the subtraction,
+		 * if it is frame-independent) of several frames concurrently, while the estimation
+		 * stays sequential. The output is the same as with one thread.
+		 * Buffer input, OLA frames (enableOLA(), each one begins with the output of the previous one),
+		 * and estimations which use the output of the frames, are always processed sequentially.
+		 *
+		 * @param value Number of threads.
+		 */
+		void setThreads(const unsigned int value);
+
 	private:
+		//! Uses a manager as its configuration, with the frame parameters and windows below.
+		friend class MultiChannelSubtractionManager;
+
 		DataSource dataSource() const;
 
 		/**
@@ -242,6 +412,18 @@ class SubtractionManager
 		 */
 		void onFFTSizeUpdate();
 
+		/**
+		 * @brief Sets the frame increments and allocates the buffers which depend on the FFT size.
+		 */
+		void allocateBuffers();
+
+		/**
+		 * @brief Copies the input and processed data of another manager, after the allocations.
+		 *
+		 * @param sm Manager to copy.
+		 */
+		void copyData(const SubtractionManager& sm);
+
 		//*** Data copying algorithms ***//
 		/**
 		 * @brief copyInput High level handler for input copying.
@@ -291,6 +473,147 @@ class SubtractionManager
 		 */
 		void copyOutputOLA(const unsigned int pos);
 
+		/**
+		 * @brief Copies the windowed frame into the fft buffer.
+		 *
+		 * Uses the weighted overlap-add method: the frame ends one hop after pos,
+		 * so that the first frames cover the beginning of the signal.
+		 *
+		 * @param pos
+		 */
+		void copyInputWOLA(const unsigned int pos);
+
+		/**
+		 * @brief Accumulates the frame weighted by the synthesis window, and writes the completed hop.
+		 *
+		 * @param pos
+		 */
+		void copyOutputWOLA(const unsigned int pos);
+
+		/**
+		 * @brief Copies the input of a frame of the whole signal (_data, or PCM samples when
+		 * frames are converted), zero outside of the signal and weighted for WOLA.
+		 *
+		 * @param start First sample of the frame, can be negative.
+		 * @param input FFT input, FFT size.
+		 */
+		void readFrame(const int start, Real * const input) const;
+
+		/**
+		 * @brief Adds the backward FFT output, weighted by the synthesis window, to a circular accumulator.
+		 *
+		 * No later frame overlaps the hop samples from head on: they are complete.
+		 *
+		 * @param acc Accumulator, FFT size.
+		 * @param head Start of the frame in the accumulator.
+		 * @return Real* The completed samples, to be consumed then reset to zero.
+		 */
+		Real *overlapAdd(Real * const acc, const unsigned int head) const;
+
+		/**
+		 * @brief Writes completed samples to the PCM output, when frames are converted.
+		 *
+		 * @param samples Samples.
+		 * @param scale Factor applied to the samples.
+		 * @param pos Position of the first sample in the signal.
+		 * @param length Number of samples.
+		 */
+		void outputFrame(const Real * const samples, const Real scale, const unsigned int pos, const unsigned int length);
+
+		/**
+		 * @brief Number of samples of the signal in a frame: one hop for OLA (zero-padded), else the FFT size.
+		 *
+		 * @return unsigned int Length.
+		 */
+		unsigned int frameInputLength() const;
+
+		/**
+		 * @brief Samples of a WOLA frame before its hop: FFT size - hop. 0 for OLA and simple frames.
+		 *
+		 * @return unsigned int Lead.
+		 */
+		unsigned int frameLead() const;
+
+		/**
+		 * @brief Computes the window tables for the FFT size, window and hop.
+		 */
+		void updateWindows();
+
+		/**
+		 * @brief Appends samples to the output file of executeToFile().
+		 *
+		 * @param samples PCM samples.
+		 * @param length Number of samples.
+		 */
+		void writeOutput(const short * samples, const unsigned int length);
+
+		/**
+		 * @brief Computes the gain of the frame with the subtraction algorithm, then floors,
+		 * smooths and applies it in a single pass.
+		 *
+		 * @param in Spectrum of the frame.
+		 * @param noise Estimated noise power.
+		 * @param out Spectrum to give to the backward FFT. Can be in.
+		 */
+		void subtract(const std::complex<Real> * const in, const Real * const noise, std::complex<Real> * const out);
+
+		/**
+		 * @brief Same as above, with the algorithm and the previous gain of an iteration.
+		 *
+		 * @param iteration Iteration of the frame, when they are fused. 0 is the main algorithm.
+		 */
+		void subtract(const std::complex<Real> * const in, const Real * const noise, std::complex<Real> * const out, const unsigned int iteration);
+
+		/**
+		 * @brief Runs the estimation and the subtraction of each iteration of the frame, in place.
+		 *
+		 * @param spectrum Spectrum of the frame.
+		 * @param subtract_last false to leave the last subtraction to the caller.
+		 * @return const Real* Noise estimated by the last iteration.
+		 */
+		const Real *processSpectrum(std::complex<Real> * const spectrum, const bool subtract_last);
+
+		/**
+		 * @brief Gives the gain of each iteration and the backward FFT output of the frame to the estimations which use them.
+		 *
+		 * The output is the one of the last iteration, when they are fused.
+		 */
+		void notifyFrameOutput();
+
+		/**
+		 * @brief Number of iterations applied to each frame of a pass: all of them when they are fused, else 1.
+		 *
+		 * @return unsigned int Iterations.
+		 */
+		unsigned int frameIterations() const;
+
+		/**
+		 * @brief Number of passes over the whole signal: 1 when the iterations are fused.
+		 *
+		 * @return unsigned int Passes.
+		 */
+		unsigned int passes() const;
+
+		/**
+		 * @brief Makes the copies of the algorithms used by the fused iterations after the first one, if needed.
+		 */
+		void updateIterationAlgorithms();
+
+		/**
+		 * @brief Processes the frame held in the FFT input buffer and accumulates its output for process().
+		 */
+		void processStreamFrame();
+
+		/**
+		 * @brief Multi-threaded version of the frame loop, for files.
+		 */
+		void executeParallel();
+
+		/**
+		 * @brief Allocates the per-thread FFTs and the frame block buffers of executeParallel().
+		 */
+		void onThreadsUpdate();
+
 
 		//*** Members ***//
 		DataSource _dataSource = DataSource::Buffer;
@@ -305,16 +628,65 @@ class SubtractionManager
 		// Storage
 		unsigned int _tabLength = 0; /**< TODO */
 
-		double *_data = nullptr; /**< TODO */
-		double *_origData = nullptr; /**< TODO */
+		Real *_data = nullptr; /**< TODO */
+		Real *_origData = nullptr; /**< TODO */
+
+		// Buffer input, kept in PCM, and file input, mapped
+		std::vector<short> _pcm = std::vector<short>(); /**< Processed buffer */
+		std::shared_ptr<MappedFile> _inputFile = nullptr; /**< Shared by the copies of the manager */
+		const short *_pcmSource = nullptr; /**< Samples to process: the mapped file, or the caller's buffer, then _pcm */
+		Real *_bufferTail = nullptr; /**< Second half of the previous overlap-add frame */
+		bool _pcmFrames = false; /**< The frame copies convert from and to _pcmSource / pcmOutput() */
+
+		// Output of executeToFile()
+		std::ostream *_outputFile = nullptr; /**< nullptr when the output is kept in memory */
+		std::vector<short> _outputPCM = std::vector<short>(); /**< Block of output samples */
 
 
 		bool _useOLA = false;
 		unsigned int _ola_frame_increment = 0; /**< TODO */
 		unsigned int _std_frame_increment = 0; /**< TODO */
 
+		// Weighted overlap-add
+		bool _useWOLA = false;
+		Window _window = Window::SqrtHann;
+		Hop _hop = Hop::Half;
+		unsigned int _wola_frame_increment = 0;
+		std::shared_ptr<const std::vector<Real>> _analysisWindow = nullptr; /**< Applied before the forward FFT. Shared by the copies */
+		std::shared_ptr<const std::vector<Real>> _synthesisWindow = nullptr; /**< Applied after the backward FFT, with its normalization. Constant without WOLA */
+		Real *_frameAcc = nullptr; /**< Circular accumulator of execute(), FFT size */
+		unsigned int _frameHead = 0; /**< Start of the accumulator */
+
 		unsigned int _iterations = 1; /**< TODO */
 
+		// Fused iterations
+		bool _fusedIterations = false;
+		std::vector<Estimation_p> _iterEstimation = std::vector<Estimation_p>(); /**< Estimation of the iterations after the first */
+		std::vector<Subtraction_p> _iterSubtraction = std::vector<Subtraction_p>(); /**< Subtraction of the iterations after the first */
+		std::vector<Real> _iterPrevGain = std::vector<Real>(); /**< Previous gain of the iterations after the first, spectrum size each */
+
+		// Gain post-processing
+		Real *_gain = nullptr; /**< Gain of the current frame */
+		Real *_prevGain = nullptr; /**< Gain of the previous frame, for smoothing */
+		Real _gainFloor = 0; /**< Minimum gain applied to a bin */
+		Real _gainSmoothing = 0; /**< Weight of the previous gain of a bin, for smoothing */
+
+		// Streaming state, allocated once per FFT size
+		Real *_streamIn = nullptr; /**< Input of the frame being filled, after the lead of the previous ones */
+		Real *_streamAcc = nullptr; /**< Overlap-add accumulator, circular, FFT size */
+		Real *_streamOut = nullptr; /**< Completed samples waiting to be output */
+		unsigned int _streamHead = 0; /**< Start of the accumulator */
+		unsigned int _streamFill = 0; /**< Samples in the frame being filled */
+
+		// Parallel file processing
+		unsigned int _threads = 1; /**< Worker threads of executeParallel() */
+		std::vector<FFT_p> _workerFFT = std::vector<FFT_p>(); /**< One FFT (and plan) per thread */
+		std::complex<Real> *_blockSpectra = nullptr; /**< Spectra of the current block of frames */
+		Real *_blockNoise = nullptr; /**< Noise estimation of each frame of the block */
+		Real *_blockGains = nullptr; /**< Gain of each frame of the block */
+		Real *_blockFrames = nullptr; /**< Normalized output of each frame of the block */
+		Real *_blockTail = nullptr; /**< Overlap of the last frame of the previous block */
+
 
 		// For measurements
 		bool _bypass = false;
@@ -0,0 +1,430 @@
+#include <subtraction_manager.h>
+#include <subtraction/algorithms.h>
+#include <estimation/algorithms.h>
+#include <fft/fftwmanager.h>
+#include <mathutils/math_util.h>
+#include <profiler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Benchmarks of libnoisered, in the manner of Google Benchmark:
+ * each benchmark is run for an increasing number of iterations until it lasts
+ * at least --min_time seconds, and the time per iteration of that run is reported.
+ *
+ * - Estimation/<algorithm>/<fft size>: one call per frame of noisy speech spectra,
+ *   with onFrameOutput() for the estimations which use it.
+ * - Subtraction/<algorithm>/<fft size>: computeGain() per frame, with a fixed noise estimation.
+ * - Execute/<estimation>/<subtraction>/<fft size>: SubtractionManager::execute() on
+ *   the whole signal, in samples per second and real-time factor (processing time / duration).
+ *
+ * Usage: libnoisered_bench [--format=json|csv] [--out=file] [--filter=substring]
+ *                          [--min_time=seconds] [--duration=seconds]
+ */
+
+namespace
+{
+	constexpr unsigned int sampling_rate = 16000;
+	const unsigned int fft_sizes[] = {256, 512, 1024, 2048, 4096};
+
+	//! Frames of spectra cycled through by the isolated benchmarks.
+	constexpr unsigned int frame_count = 64;
+
+	struct Options
+	{
+		std::string format = "json";
+		std::string out = std::string();
+		std::string filter = std::string();
+		double min_time = 0.5; /**< Seconds per benchmark */
+		double duration = 10; /**< Seconds of synthetic speech */
+	};
+
+	struct Result
+	{
+		std::string name;
+		unsigned int fft_size;
+		std::uint64_t iterations;
+		double ns_per_iteration;
+		double items_per_second;
+		double real_time_factor; /**< 0 when not relevant */
+	};
+
+	//! Deterministic uniform noise in [-1, 1).
+	class Noise
+	{
+		public:
+			double operator()()
+			{
+				_state = _state * 6364136223846793005ULL + 1442695040888963407ULL;
+				return double(_state >> 11) / double(1ULL << 52) - 1;
+			}
+
+		private:
+			std::uint64_t _state = 0x853c49e6748fea9bULL;
+	};
+
+	/**
+	 * @brief Synthetic noisy speech.
+	 *
+	 * Syllables of about 200 ms, separated by pauses, each a harmonic series of a gliding
+	 * pitch (100 to 220 Hz) with a 1/k spectral tilt, in white noise 5 dB below the speech.
+	 * The first 300 ms are noise only, for the estimations which need a noise frame.
+	 */
+	std::vector<short> noisySpeech(const double duration)
+	{
+		const auto length = (unsigned int) (duration * sampling_rate);
+		std::vector<double> speech(length, 0);
+		double phase = 0;
+		for (auto t = 0U; t < length; ++t)
+		{
+			const double time = double(t) / sampling_rate;
+			const double syllable = std::fmod(time, 0.3);
+			if (time < 0.3 || syllable > 0.2) continue;
+
+			const double pitch = 100 + 120 * (0.5 + 0.5 * std::sin(2 * M_PI * 0.7 * time));
+			const double envelope = std::sin(M_PI * syllable / 0.2);
+			phase += 2 * M_PI * pitch / sampling_rate;
+			for (auto k = 1U; k * pitch < sampling_rate / 2.0 && k <= 30; ++k)
+				speech[t] += envelope * std::sin(k * phase) / k;
+		}
+
+		double speech_power = 0;
+		for (const double s : speech) speech_power += s * s;
+		speech_power /= length;
+
+		// Uniform noise of power a^2 / 3
+		const double noise_amplitude = std::sqrt(3 * speech_power * std::pow(10.0, -0.5));
+		Noise noise;
+		double peak = 0;
+		for (double& s : speech)
+		{
+			s += noise_amplitude * noise();
+			peak = std::max(peak, std::abs(s));
+		}
+
+		std::vector<short> pcm(length);
+		std::transform(speech.begin(), speech.end(), pcm.begin(),
+					   [peak] (const double s) { return (short) std::lround(s / peak * 16384); });
+		return pcm;
+	}
+
+	/**
+	 * @brief Spectra, gains and subtracted outputs of the first frames of the signal.
+	 */
+	struct Frames
+	{
+		std::vector<std::vector<std::complex<Real>>> spectra;
+		std::vector<std::vector<Real>> gains;
+		std::vector<std::vector<Real>> outputs;
+		std::vector<Real> noise; /**< Power spectrum of the first frame, noise only */
+
+		Frames(const std::vector<short>& pcm, const unsigned int fft_size)
+		{
+			FFTWManager fft;
+			fft.updateSize(fft_size);
+			const unsigned int spectrum_size = fft.spectrumSize();
+			const unsigned int hop = fft_size / 2;
+
+			for (auto f = 0U; f < frame_count && (f * hop + fft_size) <= pcm.size(); ++f)
+			{
+				std::transform(pcm.begin() + f * hop, pcm.begin() + f * hop + fft_size, fft.input(),
+							   [] (const short s) { return Real(s) / Real(32768); });
+				fft.forward();
+				spectra.emplace_back(fft.spectrum(), fft.spectrum() + spectrum_size);
+
+				if (f == 0)
+				{
+					noise.resize(spectrum_size);
+					MathUtil::computePowerSpectrum(fft.spectrum(), noise.data(), spectrum_size);
+				}
+
+				// Magnitude subtraction of the first frame, as the frame output
+				std::vector<Real> gain(spectrum_size);
+				for (auto b = 0U; b < spectrum_size; ++b)
+				{
+					const Real magnitude = std::abs(fft.spectrum()[b]);
+					gain[b] = magnitude > 0 ? std::max(Real(0), 1 - std::sqrt(noise[b]) / magnitude) : 0;
+					fft.spectrum()[b] *= gain[b];
+				}
+				fft.backward();
+				gains.push_back(gain);
+				outputs.emplace_back(fft.output(), fft.output() + fft_size);
+			}
+		}
+	};
+
+	/**
+	 * @brief Runs fn(i) for i = 0, 1, ... until it lasts at least min_time, as Google Benchmark.
+	 *
+	 * @return Result Time per call of the last run.
+	 */
+	Result run(const std::string& name, const unsigned int fft_size, const double min_time,
+			   const std::function<void(std::uint64_t)>& fn)
+	{
+		typedef std::chrono::steady_clock clock;
+		fn(0); // Warm-up: plans, first allocations
+
+		std::uint64_t iterations = 1;
+		while (true)
+		{
+			const auto start = clock::now();
+			for (std::uint64_t i = 0; i < iterations; ++i)
+				fn(i);
+			const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+			if (seconds >= min_time || iterations >= (1ULL << 40))
+				return Result{name, fft_size, iterations, seconds * 1e9 / iterations, 0, 0};
+
+			// Aim 40 % above the minimum time, at most 10 times more iterations per run
+			const double target = seconds > 0 ? 1.4 * min_time / seconds * iterations : 10.0 * iterations;
+			iterations = std::max(iterations + 1, (std::uint64_t) std::min(target, 10.0 * iterations));
+		}
+	}
+
+	bool selected(const Options& options, const std::string& name)
+	{
+		return options.filter.empty() || name.find(options.filter) != std::string::npos;
+	}
+
+	typedef std::function<Estimation*(SubtractionManager&)> EstimationFactory;
+	typedef std::function<Subtraction*(SubtractionManager&)> SubtractionFactory;
+
+	const std::vector<std::pair<std::string, EstimationFactory>>& estimations()
+	{
+		static const std::vector<std::pair<std::string, EstimationFactory>> list =
+		{
+			{"Simple", [] (SubtractionManager& m) -> Estimation* { return new SimpleEstimation(m); }},
+			{"Martin", [] (SubtractionManager& m) -> Estimation* { return new MartinEstimation(m); }},
+			{"Wavelet", [] (SubtractionManager& m) -> Estimation* { return new WaveletEstimation(m); }},
+			{"WaveletBandLimited", [] (SubtractionManager& m) -> Estimation*
+			{
+				WaveletEstimation *estimation = new WaveletEstimation(m);
+				estimation->setBandLimited(true);
+				return estimation;
+			}}
+		};
+		return list;
+	}
+
+	const std::vector<std::pair<std::string, SubtractionFactory>>& subtractions()
+	{
+		static const std::vector<std::pair<std::string, SubtractionFactory>> list =
+		{
+			{"Simple", [] (SubtractionManager& m) -> Subtraction* { return new SimpleSpectralSubtraction(m); }},
+			{"EL", [] (SubtractionManager& m) -> Subtraction* { return new EqualLoudnessSpectralSubtraction(m); }},
+			{"Geometric", [] (SubtractionManager& m) -> Subtraction* { return new GeometricSpectralSubtraction(m); }}
+		};
+		return list;
+	}
+
+	void benchmarkEstimations(const Options& options, const std::vector<short>& pcm, std::vector<Result>& results)
+	{
+		for (const unsigned int fft_size : fft_sizes)
+		{
+			const Frames frames(pcm, fft_size);
+			for (const auto& estimation : estimations())
+			{
+				const std::string name = "Estimation/" + estimation.first + "/" + std::to_string(fft_size);
+				if (!selected(options, name)) continue;
+
+				SubtractionManager manager(fft_size, sampling_rate);
+				Estimation *algorithm = estimation.second(manager);
+				manager.setEstimationImplementation(algorithm);
+
+				// The spectra are copied: an estimation may work in place
+				std::vector<std::complex<Real>> spectrum(manager.spectrumSize());
+				Result result = run(name, fft_size, options.min_time, [&] (const std::uint64_t i)
+				{
+					const auto f = i % frames.spectra.size();
+					std::copy(frames.spectra[f].begin(), frames.spectra[f].end(), spectrum.begin());
+					(*algorithm)(spectrum.data());
+					if (algorithm->usesFrameOutput())
+						algorithm->onFrameOutput(frames.gains[f].data(), frames.outputs[f].data());
+				});
+				result.items_per_second = 1e9 / result.ns_per_iteration; // Frames
+				results.push_back(result);
+			}
+		}
+	}
+
+	void benchmarkSubtractions(const Options& options, const std::vector<short>& pcm, std::vector<Result>& results)
+	{
+		for (const unsigned int fft_size : fft_sizes)
+		{
+			const Frames frames(pcm, fft_size);
+			for (const auto& subtraction : subtractions())
+			{
+				const std::string name = "Subtraction/" + subtraction.first + "/" + std::to_string(fft_size);
+				if (!selected(options, name)) continue;
+
+				SubtractionManager manager(fft_size, sampling_rate);
+				Subtraction *algorithm = subtraction.second(manager);
+				manager.setSubtractionImplementation(algorithm);
+
+				std::vector<Real> gain(manager.spectrumSize());
+				Result result = run(name, fft_size, options.min_time, [&] (const std::uint64_t i)
+				{
+					algorithm->computeGain(frames.spectra[i % frames.spectra.size()].data(), frames.noise.data(), gain.data());
+				});
+				result.items_per_second = 1e9 / result.ns_per_iteration; // Frames
+				results.push_back(result);
+			}
+		}
+	}
+
+	void benchmarkExecute(const Options& options, const std::vector<short>& pcm,
+						  const std::string& estimation_name, const EstimationFactory& estimation,
+						  const std::string& subtraction_name, const SubtractionFactory& subtraction,
+						  const unsigned int fft_size, std::vector<Result>& results)
+	{
+		const std::string name = "Execute/" + estimation_name + "/" + subtraction_name + "/" + std::to_string(fft_size);
+		if (!selected(options, name)) return;
+
+		SubtractionManager manager(fft_size, sampling_rate);
+		manager.setEstimationImplementation(estimation(manager));
+		manager.setSubtractionImplementation(subtraction(manager));
+
+		// execute() processes the buffer given to readBuffer(), which is cheap: it does not copy it
+		Result result = run(name, fft_size, options.min_time, [&] (std::uint64_t)
+		{
+			manager.readBuffer(pcm.data(), (unsigned int) pcm.size());
+			manager.execute();
+		});
+		result.items_per_second = pcm.size() * 1e9 / result.ns_per_iteration; // Samples
+		result.real_time_factor = result.ns_per_iteration * 1e-9 / (double(pcm.size()) / sampling_rate);
+		results.push_back(result);
+	}
+
+	void benchmarkExecutes(const Options& options, const std::vector<short>& pcm, std::vector<Result>& results)
+	{
+		// Each estimation with the simple subtraction, each subtraction with the simple estimation
+		const auto& simple_estimation = estimations().front();
+		const auto& simple_subtraction = subtractions().front();
+		for (const unsigned int fft_size : fft_sizes)
+		{
+			for (const auto& estimation : estimations())
+				benchmarkExecute(options, pcm, estimation.first, estimation.second,
+								 simple_subtraction.first, simple_subtraction.second, fft_size, results);
+			for (const auto& subtraction : subtractions())
+				if (&subtraction != &simple_subtraction)
+					benchmarkExecute(options, pcm, simple_estimation.first, simple_estimation.second,
+									 subtraction.first, subtraction.second, fft_size, results);
+		}
+	}
+
+	std::string date()
+	{
+		char buffer[32] = {0};
+		const std::time_t now = std::time(nullptr);
+		std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+		return buffer;
+	}
+
+	void writeJSON(std::ostream& out, const Options& options, const std::vector<Result>& results)
+	{
+		// Same layout as the JSON output of Google Benchmark, with the real-time factor added
+		out << "{\n\t\"context\": {\n"
+			<< "\t\t\"date\": \"" << date() << "\",\n"
+			<< "\t\t\"executable\": \"libnoisered_bench\",\n"
+			<< "\t\t\"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+			<< "\t\t\"precision\": \"" << (sizeof(Real) == sizeof(float) ? "float" : "double") << "\",\n"
+			<< "\t\t\"profiling\": " << (Profiler::enabled() ? "true" : "false") << ",\n"
+			<< "\t\t\"sampling_rate\": " << sampling_rate << ",\n"
+			<< "\t\t\"signal_seconds\": " << options.duration << ",\n"
+			<< "\t\t\"min_time\": " << options.min_time << "\n"
+			<< "\t},\n\t\"benchmarks\": [";
+		for (auto i = 0U; i < results.size(); ++i)
+		{
+			const Result& r = results[i];
+			out << (i == 0 ? "\n" : ",\n")
+				<< "\t\t{\"name\": \"" << r.name << "\", \"fft_size\": " << r.fft_size
+				<< ", \"iterations\": " << r.iterations
+				<< ", \"real_time\": " << r.ns_per_iteration << ", \"time_unit\": \"ns\""
+				<< ", \"items_per_second\": " << r.items_per_second;
+			if (r.real_time_factor > 0)
+				out << ", \"real_time_factor\": " << r.real_time_factor;
+			out << "}";
+		}
+		out << "\n\t]\n}\n";
+	}
+
+	void writeCSV(std::ostream& out, const std::vector<Result>& results)
+	{
+		out << "name,fft_size,iterations,real_time_ns,items_per_second,real_time_factor\n";
+		for (const Result& r : results)
+			out << r.name << ',' << r.fft_size << ',' << r.iterations << ',' << r.ns_per_iteration << ','
+				<< r.items_per_second << ',' << r.real_time_factor << '\n';
+	}
+
+	bool parse(const int argc, char **argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const auto value = arg.substr(arg.find('=') + 1);
+			if (arg.compare(0, 9, "--format=") == 0 && (value == "json" || value == "csv"))
+				options.format = value;
+			else if (arg.compare(0, 6, "--out=") == 0)
+				options.out = value;
+			else if (arg.compare(0, 9, "--filter=") == 0)
+				options.filter = value;
+			else if (arg.compare(0, 11, "--min_time=") == 0 && std::atof(value.c_str()) > 0)
+				options.min_time = std::atof(value.c_str());
+			else if (arg.compare(0, 11, "--duration=") == 0 && std::atof(value.c_str()) >= 1)
+				options.duration = std::atof(value.c_str());
+			else
+				return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if (!parse(argc, argv, options))
+	{
+		std::cerr << "Usage: " << argv[0] << " [--format=json|csv] [--out=file] [--filter=substring]"
+				  << " [--min_time=seconds] [--duration=seconds]" << std::endl;
+		return 1;
+	}
+
+	const std::vector<short> pcm = noisySpeech(options.duration);
+	std::vector<Result> results;
+
+	benchmarkEstimations(options, pcm, results);
+	benchmarkSubtractions(options, pcm, results);
+	benchmarkExecutes(options, pcm, results);
+
+	std::ofstream file;
+	if (!options.out.empty())
+	{
+		file.open(options.out);
+		if (!file)
+		{
+			std::cerr << "Cannot write " << options.out << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& out = options.out.empty() ? std::cout : file;
+
+	if (options.format == "csv")
+		writeCSV(out, results);
+	else
+		writeJSON(out, options, results);
+
+	return 0;
+}
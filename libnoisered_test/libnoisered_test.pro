@@ -17,4 +17,10 @@ INCLUDEPATH += $$PWD/../libnoisered
 DEPENDPATH += $$PWD/../libnoisered
 
 unix:!macx: PRE_TARGETDEPS += $$PWD/../output/libnoisered.a
-LIBS += -lfftw3  -lcwt
+LIBS += -lfftw3
+
+# Single precision processing path (fftwf). Must be the same for the library and its users.
+CONFIG(float) {
+DEFINES += NOISERED_FLOAT
+LIBS += -lfftw3f
+}
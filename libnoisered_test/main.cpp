@@ -1,8 +1,24 @@
 #include <subtraction_manager.h>
+#include <multichannel_subtraction_manager.h>
 #include <subtraction/algorithms.h>
 #include <estimation/algorithms.h>
+#include <estimation/wavelets/morlet_cwt.h>
+#include <estimation/wavelets/area_labeller.h>
+#include <estimation/wavelets/cwt_noise_estimator.h>
+#include <subtraction/loudness_contour.h>
+#include <fft/fftwmanager.h>
+#include <profiler.h>
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <mathutils/math_util.h>
+#include <mathutils/subtraction_kernels.h>
+#include <mathutils/spline.hpp>
 #define DEBUG(i) // std::cerr << "OK " << (i) << std::endl;
 int main()
 {
@@ -59,6 +75,802 @@ int main()
 	s_mgr.execute();
 
 	DEBUG(6)
+	// Test : Streaming, identity subtraction on fragments not aligned with frames, then
+	// file processing with OLA, which must give the same output on one and several threads.
+	{
+		SubtractionManager stream_mgr(512, 16000);
+		stream_mgr.enableOLA();
+		stream_mgr.setEstimationImplementation(new SimpleEstimation(stream_mgr));
+		stream_mgr.setSubtractionImplementation(new SimpleSpectralSubtraction(stream_mgr)); // alpha = beta = 0
+
+		short in[4096], out[4096];
+		for (auto i = 0U; i < 4096; ++i)
+			in[i] = (short) (8000 * std::sin(i * 0.05));
+		for (auto pos = 0U; pos < 4096; pos += 300)
+			stream_mgr.process(in + pos, out + pos, std::min(300U, 4096 - pos));
+
+		const unsigned int latency = stream_mgr.streamLatency();
+		for (auto i = latency; i < 4096; ++i)
+		{
+			if (std::abs(out[i] - in[i - latency]) > 1)
+			{
+				std::cerr << "Streaming mismatch at sample " << i << std::endl;
+				return 1;
+			}
+		}
+
+		// Noise only at first, so that the estimation leaves the tone untouched
+		for (auto i = 0U; i < 4096; ++i)
+			in[i] = (short) ((i < 1024 ? 0 : in[i]) + (i * 7919 % 2000) - 1000);
+
+		SimpleSpectralSubtraction* stream_sub = new SimpleSpectralSubtraction(stream_mgr);
+		stream_sub->setAlpha(2);
+		stream_sub->setBeta(0.01);
+		stream_mgr.setSubtractionImplementation(stream_sub);
+		stream_mgr.onDataUpdate();
+		stream_mgr.resetStream();
+		stream_mgr.process(in, out, 4096);
+
+		std::ofstream raw("stream_test.raw", std::ios_base::binary);
+		raw.write((const char *) in, sizeof(in));
+		raw.close();
+
+		SubtractionManager file_mgr(stream_mgr);
+		file_mgr.readFile("stream_test.raw");
+		file_mgr.execute();
+		std::vector<Real> sequential(file_mgr.getData(), file_mgr.getData() + 4096);
+
+		file_mgr.setThreads(4);
+		file_mgr.execute();
+		for (auto i = 0U; i < 4096; ++i)
+		{
+			if (file_mgr.getData()[i] != sequential[i])
+			{
+				std::cerr << "Parallel OLA mismatch at sample " << i << std::endl;
+				return 1;
+			}
+		}
+
+		// Writing to a file as the frames are computed gives the same output
+		for (auto threads : {4U, 1U})
+		{
+			file_mgr.setThreads(threads);
+			file_mgr.execute();
+			file_mgr.executeToFile("stream_test_out.raw");
+
+			short written[4096] = {0};
+			std::ifstream written_file("stream_test_out.raw", std::ios_base::binary);
+			written_file.read((char *) written, sizeof(written));
+			if (written_file.gcount() != sizeof(written))
+			{
+				std::cerr << "Output file too short" << std::endl;
+				return 1;
+			}
+			for (auto i = 0U; i < 4096; ++i)
+			{
+				if (MathUtil::DoubleToShort(file_mgr.getData()[i]) != written[i])
+				{
+					std::cerr << "Output file mismatch at sample " << i << std::endl;
+					return 1;
+				}
+			}
+		}
+
+		// A gain floor of 1 cancels the subtraction, also after size changes with cached, measured plans
+		FFTWManager::setPlannerEffort(FFTWManager::PlannerEffort::Measure);
+		stream_mgr.setFftSize(1024);
+		stream_mgr.setFftSize(512);
+		FFTWManager::setPlannerEffort(FFTWManager::PlannerEffort::Estimate);
+		stream_mgr.setGainFloor(1);
+		stream_mgr.onDataUpdate();
+		stream_mgr.resetStream();
+		stream_mgr.process(in, out, 4096);
+		for (auto i = latency; i < 4096; ++i)
+		{
+			if (std::abs(out[i] - in[i - latency]) > 1)
+			{
+				std::cerr << "Gain floor mismatch at sample " << i << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	DEBUG(7)
+	// Test : PCM conversion saturates, and buffers converted frame by frame come back unchanged
+	{
+		Real samples[21];
+		short pcm[21];
+		for (auto i = 0U; i < 21; ++i)
+			samples[i] = (i % 2 ? 2 : -2) * (Real) i / 20;
+		MathUtil::realToShort(samples, pcm, 1, 21);
+		for (auto i = 0U; i < 21; ++i)
+		{
+			if (pcm[i] != MathUtil::DoubleToShort(samples[i]))
+			{
+				std::cerr << "PCM conversion mismatch at sample " << i << std::endl;
+				return 1;
+			}
+		}
+		if (pcm[19] != 32767 || pcm[20] != -32768)
+		{
+			std::cerr << "PCM conversion does not saturate" << std::endl;
+			return 1;
+		}
+
+		SubtractionManager buf_mgr(512, 16000);
+		buf_mgr.setEstimationImplementation(new SimpleEstimation(buf_mgr));
+		buf_mgr.setSubtractionImplementation(new SimpleSpectralSubtraction(buf_mgr));
+		buf_mgr.setGainFloor(1);
+
+		short in[4000], out[4000];
+		for (auto i = 0U; i < 4000; ++i)
+			in[i] = (short) (8000 * std::sin(i * 0.05) + (i * 7919 % 2000) - 1000);
+		for (auto ola : {false, true})
+		{
+			buf_mgr.setOLA(ola);
+			buf_mgr.readBuffer(in, 4000);
+			buf_mgr.onDataUpdate();
+			buf_mgr.execute();
+			buf_mgr.writeBuffer(out);
+			for (auto i = 0U; i < 4000; ++i)
+			{
+				if (std::abs(out[i] - in[i]) > 1)
+				{
+					std::cerr << "Buffer mismatch at sample " << i << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+
+	DEBUG(8)
+	// Test : Weighted overlap-add reconstructs the signal when nothing is subtracted,
+	// for buffers, files on several threads, and streams.
+	{
+		short in[4000], out[4000];
+		for (auto i = 0U; i < 4000; ++i)
+			in[i] = (short) (8000 * std::sin(i * 0.05) + (i * 7919 % 2000) - 1000);
+		std::ofstream raw("wola_test.raw", std::ios_base::binary);
+		raw.write((const char *) in, sizeof(in));
+		raw.close();
+
+		SubtractionManager wola_mgr(512, 16000);
+		wola_mgr.setEstimationImplementation(new SimpleEstimation(wola_mgr));
+		wola_mgr.setSubtractionImplementation(new SimpleSpectralSubtraction(wola_mgr));
+		wola_mgr.setGainFloor(1);
+
+		for (auto window : {SubtractionManager::Window::Hann, SubtractionManager::Window::SqrtHann, SubtractionManager::Window::Hamming})
+		{
+			for (auto hop : {SubtractionManager::Hop::Half, SubtractionManager::Hop::Quarter})
+			{
+				wola_mgr.enableWOLA(window, hop);
+
+				wola_mgr.setThreads(1);
+				wola_mgr.readBuffer(in, 4000);
+				wola_mgr.onDataUpdate();
+				wola_mgr.execute();
+				wola_mgr.writeBuffer(out);
+				for (auto i = 0U; i < 4000; ++i)
+				{
+					if (std::abs(out[i] - in[i]) > 1)
+					{
+						std::cerr << "WOLA buffer mismatch at sample " << i << std::endl;
+						return 1;
+					}
+				}
+
+				wola_mgr.setThreads(3);
+				wola_mgr.readFile("wola_test.raw");
+				wola_mgr.execute();
+				for (auto i = 0U; i < 4000; ++i)
+				{
+					if (std::abs(MathUtil::DoubleToShort(wola_mgr.getData()[i]) - in[i]) > 1)
+					{
+						std::cerr << "WOLA file mismatch at sample " << i << std::endl;
+						return 1;
+					}
+				}
+
+				wola_mgr.onDataUpdate();
+				wola_mgr.resetStream();
+				wola_mgr.process(in, out, 4000);
+				const unsigned int latency = wola_mgr.streamLatency();
+				for (auto i = latency; i < 4000; ++i)
+				{
+					if (std::abs(out[i] - in[i - latency]) > 1)
+					{
+						std::cerr << "WOLA stream mismatch at sample " << i << std::endl;
+						return 1;
+					}
+				}
+			}
+		}
+	}
+
+	DEBUG(9)
+	// Test : Fused iterations match separate passes with simple frames,
+	// when the signal ends with a complete frame, also on several threads.
+	{
+		short in[4096];
+		for (auto i = 0U; i < 4096; ++i)
+			in[i] = (short) ((i < 1024 ? 0 : 8000 * std::sin(i * 0.05)) + (i * 7919 % 2000) - 1000);
+		std::ofstream raw("fused_test.raw", std::ios_base::binary);
+		raw.write((const char *) in, sizeof(in));
+		raw.close();
+
+		SubtractionManager fused_mgr(512, 16000);
+		fused_mgr.setEstimationImplementation(new SimpleEstimation(fused_mgr));
+		SimpleSpectralSubtraction* fused_sub = new SimpleSpectralSubtraction(fused_mgr);
+		fused_sub->setAlpha(2);
+		fused_sub->setBeta(0.01);
+		fused_mgr.setSubtractionImplementation(fused_sub);
+		fused_mgr.setIterations(3);
+		fused_mgr.readFile("fused_test.raw");
+		fused_mgr.execute();
+		std::vector<Real> passes(fused_mgr.getData(), fused_mgr.getData() + 4096);
+
+		fused_mgr.setFusedIterations(true);
+		for (auto threads : {1U, 3U})
+		{
+			fused_mgr.setThreads(threads);
+			fused_mgr.execute();
+			for (auto i = 0U; i < 4096; ++i)
+			{
+				if (std::abs(MathUtil::DoubleToShort(fused_mgr.getData()[i]) - MathUtil::DoubleToShort(passes[i])) > 1)
+				{
+					std::cerr << "Fused iterations mismatch at sample " << i << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+
+	DEBUG(10)
+	// Test : Each channel of a multi-channel buffer is processed like a mono file, from the
+	// initial state at each pass: with OLA and WOLA, separate and fused iterations, on two buffers.
+	{
+		const unsigned int channels = 3;
+		short in[2][3 * 4000], out[3 * 4000], mono_in[4000];
+		for (auto i = 0U; i < 4000; ++i)
+		{
+			for (auto c = 0U; c < channels; ++c)
+			{
+				in[0][i * channels + c] = (short) ((i < 1000 ? 0 : 6000 * std::sin(i * 0.03 * (c + 1))) + ((i + 577 * c) * 7919 % 2000) - 1000);
+				in[1][i * channels + c] = (short) ((i < 1500 ? 0 : 4000 * std::sin(i * 0.05 * (c + 1))) + ((i + 331 * c) * 6007 % 1600) - 800);
+			}
+		}
+
+		struct Framing { bool wola; unsigned int iterations; bool fused; };
+		for (const Framing framing : {Framing{false, 1, false}, Framing{false, 2, false}, Framing{false, 2, true}, Framing{true, 2, true}})
+		{
+			auto configure = [&] (SubtractionManager& mgr)
+			{
+				if (framing.wola)
+					mgr.enableWOLA();
+				else
+					mgr.enableOLA();
+				mgr.setIterations(framing.iterations);
+				mgr.setFusedIterations(framing.fused);
+			};
+			auto subtraction = [] (SubtractionManager& mgr)
+			{
+				SimpleSpectralSubtraction* sub = new SimpleSpectralSubtraction(mgr);
+				sub->setAlpha(2);
+				sub->setBeta(0.01);
+				return sub;
+			};
+
+			MultiChannelSubtractionManager multi_mgr(channels, 512, 16000);
+			configure(multi_mgr.configuration());
+			multi_mgr.setEstimationImplementation(new SimpleEstimation(multi_mgr.configuration()));
+			multi_mgr.setSubtractionImplementation(subtraction(multi_mgr.configuration()));
+
+			for (auto buffer = 0U; buffer < 2; ++buffer)
+			{
+				multi_mgr.readBuffer(in[buffer], 4000);
+				multi_mgr.execute();
+				multi_mgr.writeBuffer(out);
+
+				for (auto c = 0U; c < channels; ++c)
+				{
+					SubtractionManager mono_mgr(512, 16000);
+					configure(mono_mgr);
+					mono_mgr.setEstimationImplementation(new SimpleEstimation(mono_mgr));
+					mono_mgr.setSubtractionImplementation(subtraction(mono_mgr));
+
+					for (auto i = 0U; i < 4000; ++i)
+						mono_in[i] = in[buffer][i * channels + c];
+					std::ofstream raw("multi_test.raw", std::ios_base::binary);
+					raw.write((const char *) mono_in, sizeof(mono_in));
+					raw.close();
+					mono_mgr.readFile("multi_test.raw");
+					mono_mgr.execute();
+
+					for (auto i = 0U; i < 4000; ++i)
+					{
+						if (std::abs(out[i * channels + c] - MathUtil::DoubleToShort(mono_mgr.getData()[i])) > 1)
+						{
+							std::cerr << "Multi-channel mismatch at sample " << i << " of channel " << c << " of buffer " << buffer
+									  << (framing.wola ? " (WOLA, " : " (OLA, ") << framing.iterations << (framing.fused ? " fused)" : ")") << std::endl;
+							return 1;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	DEBUG(11)
+	// Test : Managers of several sizes created, used and destroyed on several threads at once
+	// give the same output as on a single thread.
+	{
+		short in[4000];
+		for (auto i = 0U; i < 4000; ++i)
+			in[i] = (short) ((i < 1000 ? 0 : 6000 * std::sin(i * 0.04)) + (i * 7919 % 2000) - 1000);
+
+		auto run = [&in] (const unsigned int size, short * const out)
+		{
+			SubtractionManager mgr(size, 16000);
+			mgr.enableOLA();
+			mgr.setEstimationImplementation(new SimpleEstimation(mgr));
+			mgr.setSubtractionImplementation(new SimpleSpectralSubtraction(mgr));
+			mgr.setGainFloor(0.5);
+			mgr.readBuffer(in, 4000);
+			mgr.execute();
+			mgr.writeBuffer(out);
+		};
+
+		static short expected[3][4000], outputs[8][4000];
+		const unsigned int sizes[3] = {256, 512, 1024};
+		for (auto k = 0U; k < 3; ++k)
+			run(sizes[k], expected[k]);
+
+		std::vector<std::thread> workers;
+		for (auto t = 0U; t < 8; ++t)
+			workers.emplace_back([&run, &sizes, t] { for (auto r = 0U; r < 4; ++r) run(sizes[(t + r) % 3], outputs[t]); });
+		for (auto& worker : workers)
+			worker.join();
+
+		for (auto t = 0U; t < 8; ++t)
+		{
+			if (!std::equal(outputs[t], outputs[t] + 4000, expected[(t + 3) % 3]))
+			{
+				std::cerr << "Concurrent managers mismatch on thread " << t << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	DEBUG(12)
+	// Test : A copy of a manager, which shares its tables, gives the same output,
+	// also when the parameters of its algorithm change afterwards.
+	{
+		short in[4000], out[4000], copy_out[4000];
+		for (auto i = 0U; i < 4000; ++i)
+			in[i] = (short) ((i < 1000 ? 0 : 6000 * std::sin(i * 0.04)) + (i * 7919 % 2000) - 1000);
+
+		SubtractionManager el_mgr(512, 16000);
+		el_mgr.enableWOLA();
+		el_mgr.setEstimationImplementation(new MartinEstimation(el_mgr));
+		EqualLoudnessSpectralSubtraction* el_sub = new EqualLoudnessSpectralSubtraction(el_mgr);
+		el_sub->setAlpha(3);
+		el_sub->setBeta(0.8);
+		el_sub->setAlphawt(0.02);
+		el_sub->setBetawt(0.005);
+		el_mgr.setSubtractionImplementation(el_sub);
+
+		SubtractionManager copy_mgr(el_mgr);
+		el_sub->setAlpha(1);
+		static_cast<EqualLoudnessSpectralSubtraction*>(copy_mgr.getSubtractionImplementation())->setAlpha(1);
+
+		el_mgr.readBuffer(in, 4000);
+		el_mgr.execute();
+		el_mgr.writeBuffer(out);
+		copy_mgr.readBuffer(in, 4000);
+		copy_mgr.execute();
+		copy_mgr.writeBuffer(copy_out);
+		if (!std::equal(out, out + 4000, copy_out))
+		{
+			std::cerr << "Copied manager mismatch" << std::endl;
+			return 1;
+		}
+	}
+
+	DEBUG(13)
+	// Test : Loudness contours are computed once per sampling rate and FFT size,
+	// and go through the reference points (1000 Hz and 2000 Hz at 60 dB).
+	{
+		const auto contour = LoudnessContour::bins(16000, 512);
+		if (contour != LoudnessContour::bins(16000, 512) || contour == LoudnessContour::bins(8000, 512) || contour->size() != 257)
+		{
+			std::cerr << "Loudness contour cache mismatch" << std::endl;
+			return 1;
+		}
+		if (std::abs((*contour)[32] - 60) > 1e-9 || std::abs((*contour)[64] - 60) > 1e-9)
+		{
+			std::cerr << "Loudness contour mismatch" << std::endl;
+			return 1;
+		}
+	}
+
+	DEBUG(14)
+	// Test : The Morlet transform of a sine peaks at the scale of its frequency, with half its
+	// amplitude times the gain at any scale, and a wavelet estimation with fewer scales runs.
+	{
+		const unsigned int size = 512, scales = 1280;
+		MorletCWT cwt;
+		cwt.initialize(size, 2, scales, 0.05, 2.0);
+		MaskedMatrix arr(size + 4, scales + 4);
+
+		for (auto freq : {0.02, 0.05, 0.2})
+		{
+			std::vector<Real> sine(size);
+			for (auto t = 0U; t < size; ++t)
+				sine[t] = (Real) (0.3 * std::cos(2 * M_PI * freq * t));
+			cwt.transform(sine.data(), arr, 2);
+
+			const MaskedMatrix::value_type *col = arr[size / 2];
+			const auto peak = std::max_element(col + 2, col + scales) - col;
+			if (std::abs(peak * 0.05 - MorletCWT::centerFrequency() / freq) > 1 || std::abs(col[peak] - 0.3) > 0.003)
+			{
+				std::cerr << "Morlet transform mismatch" << std::endl;
+				return 1;
+			}
+		}
+
+		SubtractionManager wavelet_mgr(256, 16000);
+		WaveletEstimation* wavelet = new WaveletEstimation(wavelet_mgr);
+		wavelet->setScaleCount(320);
+		wavelet_mgr.setEstimationImplementation(wavelet);
+		wavelet_mgr.setSubtractionImplementation(new SimpleSpectralSubtraction(wavelet_mgr));
+		wavelet_mgr.readBuffer(tab, 4096);
+		wavelet_mgr.execute();
+	}
+
+	DEBUG(15)
+	// Test : The labeller finds the areas of masked pixels across the mask words,
+	// diagonals included, and ignores the unmasked values.
+	{
+		MaskedMatrix arr(8, 150);
+		for (auto j = 60U; j < 70U; ++j)
+		{
+			arr[2][j] = 1;
+			arr.mask(2, j);
+		}
+		arr[3][70] = 3;
+		arr.mask(3, 70);
+		arr[3][71] = 5; // Not masked
+		arr[5][130] = 1;
+		arr.mask(5, 130);
+
+		std::vector<Area> areas;
+		AreaLabeller labeller;
+		labeller.label(arr, 0, arr.size(), 0, arr.rows(), areas);
+		if (areas.size() != 2 || areas[0].getNumPixels() != 11 || areas[0].getWidth() != 2 ||
+				areas[0].getMax()._y != 70 || areas[0].getSumOfValues() != 13)
+		{
+			std::cerr << "Area labelling mismatch" << std::endl;
+			return 1;
+		}
+	}
+
+	DEBUG(16)
+	// Test : With one scale per bin, a sine peaks at its bin, and the decimated
+	// transform gives the same magnitudes as the full one at its samples. The band-limited
+	// estimator lowers the noise of the same bins as the full one, by nearly the same power.
+	{
+		const unsigned int size = 512, bin = 40;
+		MorletCWT full, decimated;
+		full.initializeBins(size, 7, 1.0, 1);
+		decimated.initializeBins(size, 7, 1.0, 4);
+		MaskedMatrix full_arr(size, full.scaleCount()), decimated_arr(size / 4, decimated.scaleCount());
+
+		std::vector<Real> sine(size);
+		for (auto t = 0U; t < size; ++t)
+			sine[t] = (Real) std::cos(2 * M_PI * bin * t / size);
+		full.transform(sine.data(), full_arr, 0);
+		decimated.transform(sine.data(), decimated_arr, 0);
+
+		const MaskedMatrix::value_type *col = full_arr[size / 2];
+		const auto peak = std::max_element(col + 7, col + full.scaleCount()) - col;
+		double diff = 0;
+		for (auto m = 0U; m < size / 4; ++m)
+			for (auto k = 7U; k < full.scaleCount(); ++k)
+				diff = std::max(diff, (double) std::abs(full_arr[4 * m][k] - decimated_arr[m][k]));
+		if (std::abs(peak - (long) bin) > 1 || diff > 1e-3 * col[peak])
+		{
+			std::cerr << "Band-limited Morlet transform mismatch" << std::endl;
+			return 1;
+		}
+
+		// Short tone bursts, as left by a subtraction, in the unnormalized output of a frame
+		SubtractionManager config(size, 16000);
+		const unsigned int spectrum_size = config.spectrumSize();
+		CWTNoiseEstimator full_estimator, band_estimator;
+		band_estimator.setBandLimited(true);
+		full_estimator.initialize(config);
+		band_estimator.initialize(config);
+
+		const unsigned int bursts[3][3] = {{48, 95, 160}, {60, 120, 200}, {75, 140, 230}};
+		for (const auto& burst_bins : bursts)
+		{
+			std::vector<Real> frame(size, 0), gain(spectrum_size, 1);
+			for (auto b : burst_bins)
+			{
+				const unsigned int start = 60 + b % 7 * 40, length = 96;
+				for (auto t = 0U; t < length; ++t)
+				{
+					const double envelope = std::sin(M_PI * t / length);
+					frame[start + t] += (Real) (size * 0.01 * envelope * envelope * std::cos(2 * M_PI * b * t / size));
+				}
+				std::fill_n(gain.begin() + b - 3, 7, (Real) 0.5);
+			}
+
+			std::vector<Real> full_noise(spectrum_size, 1000), band_noise(spectrum_size, 1000);
+			full_estimator.detect(frame.data(), true);
+			full_estimator.reestimateNoise(full_noise.data());
+			band_estimator.selectBands(gain.data());
+			band_estimator.detect(frame.data(), true);
+			band_estimator.reestimateNoise(band_noise.data());
+
+			// One bin per burst in both modes. The full scalogram has one scale step between
+			// its rows, b^2 * step / (centre frequency * size) bins: more than one at high bins.
+			std::vector<unsigned int> full_bins, band_bins;
+			for (auto b = 0U; b < spectrum_size; ++b)
+			{
+				if (full_noise[b] < 1000) full_bins.push_back(b);
+				if (band_noise[b] < 1000) band_bins.push_back(b);
+			}
+			if (full_bins.size() != 3 || band_bins.size() != 3)
+			{
+				std::cerr << "Band-limited detection mismatch" << std::endl;
+				return 1;
+			}
+			for (auto i = 0U; i < 3; ++i)
+			{
+				const double b = full_bins[i];
+				const double tolerance = 1 + b * b * 0.05 / (MorletCWT::centerFrequency() * size);
+				const double full_power = 1000 - full_noise[full_bins[i]], band_power = 1000 - band_noise[band_bins[i]];
+				if (std::abs(b - band_bins[i]) > tolerance || std::abs(band_power - full_power) > 0.02 * full_power)
+				{
+					std::cerr << "Band-limited detection mismatch at bin " << full_bins[i] << std::endl;
+					return 1;
+				}
+			}
+		}
+
+		SubtractionManager wavelet_mgr(256, 16000);
+		WaveletEstimation* wavelet = new WaveletEstimation(wavelet_mgr);
+		wavelet->setBandLimited(true);
+		wavelet_mgr.setEstimationImplementation(wavelet);
+		wavelet_mgr.setSubtractionImplementation(new SimpleSpectralSubtraction(wavelet_mgr));
+		wavelet_mgr.readBuffer(tab, 4096);
+		wavelet_mgr.execute();
+	}
+
+	DEBUG(17)
+	// Test : The wavelet estimation starts from the simple one, and only lowers it on the bins
+	// of the musical tones found in the output of the previous frame. In the manager, the output
+	// then keeps more of the signal than with the simple estimation.
+	{
+		const unsigned int size = 512;
+		SubtractionManager config(size, 16000);
+		const unsigned int spectrum_size = config.spectrumSize();
+		WaveletEstimation wavelet(config);
+		SimpleEstimation simple(config);
+		wavelet.onFFTSizeUpdate();
+		simple.onFFTSizeUpdate();
+
+		// A frame of noise, then louder frames, after which the output holds tone bursts
+		std::vector<std::complex<Real>> noise_spectrum(spectrum_size, 1), loud_spectrum(spectrum_size, 10);
+		std::vector<Real> gain(spectrum_size, (Real) 0.5), output(size, 0);
+		for (auto b : {48U, 95U, 160U})
+		{
+			const unsigned int start = 60 + b % 7 * 40, length = 96;
+			for (auto t = 0U; t < length; ++t)
+			{
+				const double envelope = std::sin(M_PI * t / length);
+				output[start + t] += (Real) (size * 0.01 * envelope * envelope * std::cos(2 * M_PI * b * t / size));
+			}
+		}
+		simple(noise_spectrum.data());
+		wavelet(noise_spectrum.data());
+		wavelet(loud_spectrum.data());
+		wavelet.onFrameOutput(gain.data(), output.data());
+		wavelet(loud_spectrum.data());
+
+		std::vector<unsigned int> lowered;
+		for (auto b = 0U; b < spectrum_size; ++b)
+		{
+			if (wavelet.noisePower()[b] > simple.noisePower()[b])
+			{
+				std::cerr << "Wavelet estimation above the simple one at bin " << b << std::endl;
+				return 1;
+			}
+			if (wavelet.noisePower()[b] < simple.noisePower()[b])
+				lowered.push_back(b);
+		}
+		if (lowered.size() != 3 || std::abs((int) lowered[0] - 48) > 1 || std::abs((int) lowered[1] - 95) > 1 ||
+				std::abs((int) lowered[2] - 160) > 1)
+		{
+			std::cerr << "Wavelet estimation mismatch on the tones" << std::endl;
+			return 1;
+		}
+
+		short in[8192], out[2][8192];
+		unsigned int seed = 1;
+		for (auto i = 0U; i < 8192; ++i)
+		{
+			seed = seed * 1103515245 + 12345;
+			in[i] = (short) ((i < 1024 ? 0 : 8000 * std::sin(i * 0.05)) + (seed >> 8) % 2000 - 1000.0);
+		}
+
+		double energy[2] = {0, 0};
+		for (auto use_wavelet : {false, true})
+		{
+			SubtractionManager mgr(512, 16000);
+			if (use_wavelet)
+				mgr.setEstimationImplementation(new WaveletEstimation(mgr));
+			else
+				mgr.setEstimationImplementation(new SimpleEstimation(mgr));
+			SimpleSpectralSubtraction* sub = new SimpleSpectralSubtraction(mgr);
+			sub->setAlpha(3);
+			sub->setBeta(0.01);
+			mgr.setSubtractionImplementation(sub);
+			mgr.readBuffer(in, 8192);
+			mgr.execute();
+			mgr.writeBuffer(out[use_wavelet]);
+			for (auto i = 0U; i < 8192; ++i)
+				energy[use_wavelet] += double(out[use_wavelet][i]) * out[use_wavelet][i];
+		}
+
+		double input_energy = 0;
+		for (auto i = 0U; i < 8192; ++i)
+			input_energy += double(in[i]) * in[i];
+		if (!(energy[0] < input_energy) || !(energy[1] > energy[0]) || std::equal(out[0], out[0] + 8192, out[1]))
+		{
+			std::cerr << "Wavelet estimation mismatch" << std::endl;
+			return 1;
+		}
+	}
+
+	DEBUG(18)
+	// Test : The stages of the frames are timed once per frame only when profiling is enabled,
+	// the frame output only for the estimations which use it, and the dumps hold every stage.
+	{
+		SubtractionManager mgr(512, 16000);
+		mgr.setSubtractionImplementation(new SimpleSpectralSubtraction(mgr));
+		const std::uint64_t frames = Profiler::enabled() ? 8 : 0;
+		for (auto frame_output : {false, true})
+		{
+			Profiler::reset();
+			if (frame_output)
+				mgr.setEstimationImplementation(new WaveletEstimation(mgr));
+			else
+				mgr.setEstimationImplementation(new SimpleEstimation(mgr));
+			mgr.readBuffer(tab, 4096);
+			mgr.execute();
+
+			for (auto s = 0U; s < Profiler::stage_count; ++s)
+			{
+				const Profiler::Statistics stats = Profiler::statistics((Profiler::Stage) s);
+				const bool timed = frame_output || (Profiler::Stage) s != Profiler::Stage::FrameOutput;
+				if (stats.count != (timed ? frames : 0) || stats.percentile(0.5) > stats.max)
+				{
+					std::cerr << "Profiler mismatch for " << Profiler::stageName((Profiler::Stage) s) << std::endl;
+					return 1;
+				}
+			}
+		}
+
+		std::ostringstream json, csv;
+		Profiler::dumpJSON(json);
+		Profiler::dumpCSV(csv);
+		if (json.str().find("\"backwardFFT\"") == std::string::npos || csv.str().find("all,copyOutput,") == std::string::npos)
+		{
+			std::cerr << "Profiler dump mismatch" << std::endl;
+			return 1;
+		}
+	}
+
+	DEBUG(19)
+	// Test : Streaming gives the output of execute() on the whole buffer, delayed by the latency,
+	// with frames without overlap and with WOLA. (With enableOLA(), execute() feeds the tail of
+	// a frame back into the next one, process() adds it to the output.)
+	{
+		short in[8192], out[8192], stream[8192];
+		for (auto i = 0U; i < 8192; ++i)
+			in[i] = (short) ((i < 2048 ? 0 : 6000 * std::sin(i * 0.07)) + (i * 7919 % 2000) - 1000);
+
+		for (const bool wola : {false, true})
+		{
+			SubtractionManager mgr(512, 16000);
+			if (wola) mgr.enableWOLA();
+			mgr.setEstimationImplementation(new SimpleEstimation(mgr));
+			SimpleSpectralSubtraction* sub = new SimpleSpectralSubtraction(mgr);
+			sub->setAlpha(2);
+			mgr.setSubtractionImplementation(sub);
+
+			SubtractionManager stream_mgr(mgr);
+			for (auto pos = 0U; pos < 8192; pos += 300)
+				stream_mgr.process(in + pos, stream + pos, std::min(300U, 8192 - pos));
+
+			mgr.readBuffer(in, 8192);
+			mgr.execute();
+			mgr.writeBuffer(out);
+
+			const unsigned int latency = stream_mgr.streamLatency();
+			for (auto i = 0U; i < 8192 - latency; ++i)
+			{
+				if (std::abs(stream[i + latency] - out[i]) > 1)
+				{
+					std::cerr << "Streaming / execute mismatch at sample " << i << (wola ? " (WOLA)" : "") << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+
+	DEBUG(20)
+	// Test : The natural cubic spline goes through its points, matches values computed by hand
+	// and is exact on a line, and evaluate() gives the values of operator().
+	{
+		auto near = [] (const double a, const double b) { return std::abs(a - b) < 1e-9; };
+
+		MathUtil::Spline peak;
+		peak.addPoint(0, 0);
+		peak.addPoint(1, 1);
+		peak.addPoint(2, 0);
+		// Second derivatives 0, -3, 0
+		if (!near(peak(0.5), 0.6875) || !near(peak(1.5), 0.6875) || !near(peak(1), 1))
+		{
+			std::cerr << "Spline mismatch on a peak" << std::endl;
+			return 1;
+		}
+
+		MathUtil::Spline line;
+		for (const double x : {0.0, 0.5, 2.0, 3.5})
+			line.addPoint(x, 2 * x + 1);
+		for (const double x : {-1.0, 0.25, 1.25, 3.0, 5.0})
+		{
+			if (!near(line(x), 2 * x + 1))
+			{
+				std::cerr << "Spline mismatch on a line at " << x << std::endl;
+				return 1;
+			}
+		}
+
+		// The loudness contour, at the bins of 5 Hz which are reference frequencies
+		const double points[][2] = {{20, 109.5}, {25, 104.2}, {40, 94.2}, {50, 90.0}, {80, 82.1}, {100, 78.7},
+									{125, 75.6}, {400, 63.5}, {1000, 60.0}, {2000, 60.0}, {4000, 57.6}, {8000, 71.7}};
+		const auto contour = LoudnessContour::bins(16000, 3200);
+		MathUtil::Spline loudness;
+		for (const auto& point : points)
+		{
+			if (!near((*contour)[(unsigned int) point[0] / 5], point[1]))
+			{
+				std::cerr << "Loudness contour mismatch at " << point[0] << " Hz" << std::endl;
+				return 1;
+			}
+			loudness.addPoint(point[0], point[1]);
+		}
+
+		std::vector<double> xs, values;
+		for (double x = 0; x < 9000; x += 7.3)
+			xs.push_back(x);
+		values.resize(xs.size());
+		loudness.evaluate(xs.data(), values.data(), xs.size());
+		for (auto i = 0U; i < xs.size(); ++i)
+		{
+			if (!near(values[i], loudness(xs[i])))
+			{
+				std::cerr << "Spline evaluate() mismatch at " << xs[i] << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	DEBUG(21)
 
 	return 0;
 }